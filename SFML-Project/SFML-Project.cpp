@@ -4,6 +4,9 @@
 #include <fstream>
 #include <time.h>
 #include <sstream>
+#include <thread>
+#include <future>
+#include <memory>
 
 
 using namespace std;
@@ -11,6 +14,16 @@ using namespace std;
 //Our files
 #include "game_objects.h"
 #include "level_manager.h"
+#include "render_thread.h"
+#include "particle_system.h"
+#include "benchmarks.h"
+#include "asset_loader.h"
+#include "asset_cooker.h"
+#include "file_watcher.h"
+#include "save_file.h"
+#include "profile_store.h"
+#include "save_writer.h"
+#include "rewind_buffer.h"
 
 //SFML files
 #include "SFML/Graphics.hpp"
@@ -22,57 +35,144 @@ using namespace std;
 //SFML namespace
 using namespace sf;
 
-//file out function
-void saveData(string player_name,int levelHere, int timeOn) {
-    string path = "playerStats.txt";
-    ofstream writer;
-    writer.open(path);
-    if(writer.is_open())
-    {
-       
-        writer << player_name << "," << levelHere << "," << timeOn;
-                    
-    }
-    else
-    {
-        cout << "error reading from file" << endl;
-    }
+//Print how even the frame times were, how often the motion stuttered, and how even the simulation ticks were
+void print_frame_stats(pacing_mode mode, frame_stats stats, frame_stats tick_stats) {
+    cout << frame_pacer::get_mode_name(mode) << ": " << stats.frame_count << " frames, average " << stats.average << "ms, variance " << stats.variance
+        << "ms^2, std dev " << stats.standard_deviation << "ms, longest " << stats.longest << "ms" << endl;
+    cout << "  Motion: " << stats.repeated_frames << " frames repeated a tick, " << stats.skipped_ticks << " ticks never shown" << endl;
+    cout << "  Simulation: " << tick_stats.frame_count << " ticks, average " << tick_stats.average << "ms, std dev " << tick_stats.standard_deviation
+        << "ms, longest " << tick_stats.longest << "ms" << endl;
+}
 
+//Fill a draw list with a loading bar in the middle of the screen
+void build_loading_screen(draw_list& list, float progress) {
+    list.clear();
+    FloatRect bar(400, 380, 600, 40);
+    FloatRect filled(bar.left + 4, bar.top + 4, (bar.width - 8) * progress, bar.height - 8);
+    Color colors[2] = { Color(40, 40, 40), Color(120, 255, 120) };
+    FloatRect rects[2] = { bar, filled };
+    for (int i = 0; i < 2; i++) {
+        list.shapes.append(Vertex(Vector2f(rects[i].left, rects[i].top), colors[i]));
+        list.shapes.append(Vertex(Vector2f(rects[i].left + rects[i].width, rects[i].top), colors[i]));
+        list.shapes.append(Vertex(Vector2f(rects[i].left + rects[i].width, rects[i].top + rects[i].height), colors[i]));
+        list.shapes.append(Vertex(Vector2f(rects[i].left, rects[i].top + rects[i].height), colors[i]));
+    }
 }
 
-void delete_save() {
-    string path = "playerStats.txt";
-    string name , line;
-    int level, seconds;
-    string level_string, seconds_string;
-    ifstream reader; // Open file in truncate mode
-    reader.open(path);
-    if (reader.is_open()) {
-        while (getline(reader, line)) {
-            stringstream ss(line);
-            getline(ss, name, ',');
-            getline(ss, level_string, ',');
-            stringstream level_stream(level_string);
-            level_stream >> level;
-            getline(ss, seconds_string, ',');
-            stringstream seconds_stream(seconds_string);
-            seconds_stream >> seconds;
-            reader.close();
+//What the player picked in the start menu
+struct menu_choice {
+    int selection = 0;
+    string player_name;
+};
+
+//Asks whether to start a new game or continue in the console
+//Runs on its own thread so the window keeps drawing (and assets keep loading) while we wait for an answer
+future<menu_choice> start_menu() {
+    shared_ptr<promise<menu_choice>> choice = make_shared<promise<menu_choice>>();
+    future<menu_choice> result = choice->get_future();
+    //Detached so closing the window doesn't have to wait for someone to type something
+    thread([choice] {
+        menu_choice picked;
+        //Inital message
+        cout << "Welcome to SFML.SLIME!" << endl;
+        //New game or continue
+        cout << "1. Start New Game" << endl << "2. Continue From Existing Save File" << endl;
+        //Get user selection
+        cin >> picked.selection;
+        if (picked.selection == 1 || picked.selection == 2) {
+            cout << endl << "Enter Your Name:" << endl;
+            cin >> picked.player_name;
+            //Longer names can't be saved (see profile_store::save)
+            while (cin && picked.player_name.size() > profile_store::get_max_name_length()) {
+                cout << "Names can be at most " << profile_store::get_max_name_length() << " characters. Enter Your Name:" << endl;
+                cin >> picked.player_name;
+            }
         }
+        choice->set_value(picked);
+    }).detach();
+    return result;
+}
+
+//Every sound the game plays, in the order they're indexed in sounds
+vector<string> get_sound_files() {
+    return {
+       "jump.wav",   //jump                          0    keycodes for calling sound
+       "pop.wav",  //complete level                  1
+       "explode.wav", //death                        2
+       "click.wav",  //click                         3
+       "notify.wav", //notification ping             4
+       "background.wav"//background music            5
+    };
+}
+
+//Every file that goes in the asset pack
+vector<string> get_pack_files() {
+    vector<string> files = { "sky.JPG" };
+    files.insert(files.end(), get_object_texture_files().begin(), get_object_texture_files().end());
+    vector<string> sound_files = get_sound_files();
+    files.insert(files.end(), sound_files.begin(), sound_files.end());
+    return files;
+}
+
+//Asks the save writer to save the player's progress (written in the background)
+void saveData(save_writer& saves, string player_name, int levelHere, int timeOn, player* plyr) {
+    save_record record;
+    record.player_name = player_name;
+    record.level = levelHere;
+    record.play_time = timeOn;
+    if (plyr) {
+        record.health = plyr->get_health();
+        record.power_up_ticks = plyr->is_speed_boosted() ? plyr->get_powerup_duration() : 0;
     }
-    else {
-        cout << "Could not find player in file." << endl;
-    }
-    ofstream writer;
-    writer.open(path);
-    if (writer.is_open()) {
-        writer << name << ',' << 1  << ',' << seconds;
-    }
+    saves.save(record);
+}
+
+//Game over: back to the first level with full health, keeping the name and play time
+void delete_save(save_writer& saves, string player_name, int timeOn) {
+    saveData(saves, player_name, 1, timeOn, nullptr);
 }
 
 
-int main()
+int main(int argc, char* argv[])
 {
+    //Cook every asset into one pack file and exit: SFML-Project --build-pack [pack file]
+    if (argc >= 2 && string(argv[1]) == "--build-pack") {
+        string pack_path = argc >= 3 ? argv[2] : "assets.pak";
+        if (!asset_cooker::cook_pack(pack_path, get_pack_files()))
+            return -1;
+        cout << "Built " << pack_path << endl;
+        return 0;
+    }
+    //Benchmarks and self checks (see benchmarks.h): SFML-Project --bench-particles | --bench-broadphase | --bench-solver | --bench-collisions | --bench-jobs | --bench-transitions | --bench-assets | --bench-rewind
+    if (argc >= 2 && string(argv[1]) == "--bench-particles") {
+        job_system jobs;
+        return bench_particles(jobs) ? 0 : -1;
+    }
+    if (argc >= 2 && string(argv[1]) == "--bench-broadphase") {
+        return bench_broadphase() ? 0 : -1;
+    }
+    if (argc >= 2 && string(argv[1]) == "--bench-solver") {
+        return bench_solver() ? 0 : -1;
+    }
+    if (argc >= 2 && string(argv[1]) == "--bench-collisions") {
+        job_system jobs;
+        return bench_parallel_collisions(jobs) ? 0 : -1;
+    }
+    if (argc >= 2 && string(argv[1]) == "--bench-jobs") {
+        job_system jobs;
+        return bench_jobs(jobs) ? 0 : -1;
+    }
+    if (argc >= 2 && string(argv[1]) == "--bench-transitions") {
+        job_system jobs;
+        return bench_transitions(jobs) ? 0 : -1;
+    }
+    if (argc >= 2 && string(argv[1]) == "--bench-assets") {
+        return bench_assets(get_pack_files()) ? 0 : -1;
+    }
+    if (argc >= 2 && string(argv[1]) == "--bench-rewind") {
+        return bench_rewind() ? 0 : -1;
+    }
+
     //Variables
     string player_name;
     int user_selection;
@@ -81,100 +181,125 @@ int main()
     bool is_right_pressed = false;
     bool is_jump_pressed = false;
     bool is_down_pressed = false;
+    bool is_rewind_pressed = false;
+    //Draws every object's hitbox on top of the level (toggled with F1)
+    bool show_collision_debug = false;
+    //Quick save (F5 saves the whole state of the current level, F9 puts it back)
+    level_snapshot quick_save;
+    //The last 10 seconds of play, for rewinding (hold R)
+    rewind_buffer rewind;
+    //Time spent in detect_collisions() since the broadphase was last switched (F3), to compare the broadphases
+    Time collision_time;
+    int collision_ticks = 0;
     //file variables
     string userOn;
-    int levelOn, timeOn;
+    int levelOn = 1, timeOn = 0;
 
 
-    //sky background
-    Texture background_texture;
-    background_texture.loadFromFile("sky.JPG");
+    //Some of the following code is based on the offical SFML documentation (https://www.sfml-dev.org/documentation/2.6.2/)
+    //Create window with SFML. It opens straight away and shows a loading bar while the assets load
+    RenderWindow window(VideoMode(1400, 800), "Game Title", Style::Titlebar | Style::Close);
+    //SFML input detection
+    Event input_event;
+    //The simulation runs at a fixed 60 ticks per second (some movement is still tuned per tick)
+    const Time tick_length = seconds(1.0f / 60.0f);
 
-    // Create a sprite and set the texture
+    //sky background (its texture is set once it has loaded)
     Sprite background_sprite;
-    background_sprite.setTexture(background_texture);
-
-
-
-
-    // get data from file
 
+    //Rendering runs on its own thread. The main thread handles input and the simulation, then publishes a draw list every tick
+    render_thread renderer;
+    //Frames are paced by the render thread (F2 cycles through the pacing modes)
+    renderer.start(window, background_sprite, pacing_precise);
 
+    //Job system shared by everything that wants to spread work over the cores. Must outlive the level manager
+    job_system jobs;
 
-    string path = "playerStats.txt";
-    ifstream reader;
-    reader.open(path);
-    if (reader.is_open())
-    {
-
-        string name_s, level_i, time_i;
-        double level, time;
+    //Assets are read out of the asset pack if there is one (see --build-pack), otherwise from the loose files
+    asset_pack pack;
+    if (pack.open("assets.pak"))
+        cout << "Loading assets from assets.pak" << endl;
 
-        getline(reader, name_s, ',');
-        getline(reader, level_i, ',');
-        try {
-
-            level = stoi(level_i);
+    //Start loading every asset in the background
+    asset_loader assets(jobs, renderer, &pack);
+    asset_handle<Texture> background_texture = assets.load_texture("sky.JPG");
+    for (const string& file_name : get_object_texture_files()) {
+        assets.load_texture(file_name);
+    }
 
-        }
-        catch (const out_of_range&) {
-            level = 1;
-            cout << "out of range error reverting to 0" << endl;
-        }
-        catch (const invalid_argument& e) {
-            level = 1;
-            cout << "out of range error reverting to 0" << endl;
-        }
 
 
-        getline(reader, time_i);
-        try {
 
-            time = stoi(time_i);
-            if (time < 0)
-            {
-                time = 0; cout << "reverting time to 0" << endl;
-            }
-        }
-        catch (const out_of_range&) {
-            time = 0;
-            cout << "overflow error reverting to 0" << endl;
-        }
+    // get data from file
 
 
 
-        userOn = name_s;
-        levelOn = level;
-        timeOn = time;
-    }
-    else {
+    //Every player's save. The first time the game runs with profiles, the old single save is moved in
+    profile_store profiles;
+    if (!profiles.open("profiles"))
         cout << "failed to read from file" << endl;
+    save_record legacy_save;
+    if (profiles.get_profile_count() == 0 && save_file::load(legacy_save)) {
+        cout << "Moving " << legacy_save.player_name << "'s save into the profiles" << endl;
+        profiles.save(legacy_save);
     }
-    reader.close();
     //cout << userOn<<" "<< levelOn<<" " << timeOn << endl; //debug
 
 
 
         //SOUND
 
-    vector<string> audioFiles = {
-       "jump.wav",   //jump                          0    keycodes for calling sound
-       "pop.wav",  //complete level                  1
-       "explode.wav", //death                        2
-       "click.wav",  //click                         3
-       "notify.wav", //notification ping             4
-       "background.wav"//background music            5
-    };
-    vector<SoundBuffer> soundBuffers(audioFiles.size()); //storing sound buffers
+    vector<string> audioFiles = get_sound_files();
+    vector<asset_handle<SoundBuffer>> soundBuffers; //storing sound buffers (loaded in the background)
     vector<Sound> sounds(audioFiles.size());
+    for (const string& file_name : audioFiles) {
+        soundBuffers.push_back(assets.load_sound(file_name));
+    }
+
+    //Ask the player what they want to do while everything loads
+    future<menu_choice> menu = start_menu();
+    menu_choice choice;
+    bool has_choice = false;
+
+    //Loading screen. Keeps the window responsive until the assets are loaded and the player has picked from the menu
+    float loading_progress = 0;
+    assets.set_progress_callback([&](int finished, int requested) { loading_progress = finished / (float)requested; });
+    while (!assets.is_done() || !has_choice) {
+        while (window.pollEvent(input_event)) {
+            if (input_event.type == Event::Closed || (input_event.type == Event::KeyPressed && input_event.key.code == Keyboard::Escape)) {
+                renderer.stop();
+                window.close();
+                return 0;
+            }
+        }
+        if (!has_choice && menu.wait_for(chrono::seconds(0)) == future_status::ready) {
+            choice = menu.get();
+            has_choice = true;
+        }
+
+        assets.poll();
+        build_loading_screen(renderer.get_write_buffer(), loading_progress);
+        renderer.publish();
+        sleep(tick_length);
+    }
+
+    //Everything has loaded. The background sprite is being drawn by the render thread, so it has to be changed there
+    renderer.run_on_render_thread([&] { background_sprite.setTexture(background_texture.get()); });
+    //Platforms and jump pads tile their textures. That touches OpenGL, so it's done by the render thread too (before the first level is drawn)
+    renderer.run_on_render_thread([] {
+        for (const string& file_name : get_tiled_texture_files()) {
+            texture_cache::get_texture(file_name).setRepeated(true);
+        }
+    });
 
     //creating loop to set each sound to each buffer
     for (int i = 0; i < audioFiles.size(); ++i) {
-        if (!soundBuffers[i].loadFromFile(audioFiles[i])) {
-            cout << "Error loading sound file: " << audioFiles[i] << endl;
+        if (!soundBuffers[i].succeeded()) {
+            renderer.stop();
+            window.close();
             return -1;
         }
-        sounds[i].setBuffer(soundBuffers[i]);
+        sounds[i].setBuffer(soundBuffers[i].get());
     }
 
     sounds[5].setPitch(0.75f); //speed modifier and pitch
@@ -182,6 +307,19 @@ int main()
     sounds[5].setVolume(90.0f); //100 is default and max
     sounds[5].play();
 
+    //Look up the player's save now that we know who they are
+    save_record save;
+    bool has_save = choice.selection == 2 && profiles.find(choice.player_name, save);
+    userOn = choice.player_name;
+    if (has_save)
+    {
+        levelOn = save.level;
+        timeOn = save.play_time;
+    }
+    else if (choice.selection == 2) {
+        cout << "No save found for " << choice.player_name << ", starting a new game" << endl;
+    }
+
     //Tracking time
 
     Clock clock;
@@ -207,23 +345,17 @@ int main()
 
 
 
-    //Level manager
-    level_manager levels = level_manager();
+    //Level manager. Built after loading so none of the level's objects have to wait on a texture
+    level_manager levels;
+    levels.set_job_system(&jobs);
 
 
 
-
-    //Inital message
-    cout << "Welcome to SFML.SLIME!" << endl;
-    //New game or continue
-    cout << "1. Start New Game" << endl << "2. Continue From Existing Save File" << endl;
-    //Get user selection
-    cin >> user_selection;
+    user_selection = choice.selection;
     switch (user_selection) {
     case 1:
         //New game
-        cout << endl << "Enter Your Name:" << endl;
-        cin >> player_name;
+        player_name = choice.player_name;
 
 
 
@@ -240,29 +372,61 @@ int main()
 
          //Code for testing only, should be setting it to whatever the saved level id is
         levels.set_current_level(levelOn);
-        cout << "Welcome back " << player_name << "!" << endl;
-        cout << "Current Playtime " << hours << ":" << smallMinutes << ":" << smallSeconds << endl;
+        if (has_save) {
+            if (player* plyr = dynamic_cast<player*>(levels.get_current_level()->at(0)))
+                plyr->restore_saved_state(save.health, save.power_up_ticks);
+            cout << "Welcome back " << player_name << "!" << endl;
+            cout << "Current Playtime " << hours << ":" << smallMinutes << ":" << smallSeconds << endl;
+        }
 
 
         break;
     default:
 
         cout << endl << "Invalid input!" << endl;
+        renderer.stop();
+        window.close();
         return -1;
         break;
     }
+    //Neither the chosen level nor level 1 could be loaded, so there's nothing to play
+    if (!levels.get_current_level()) {
+        renderer.stop();
+        window.close();
+        return -1;
+    }
 
-    //Some of the following code is based on the offical SFML documentation (https://www.sfml-dev.org/documentation/2.6.2/)
-    //Create window with SFML
-    RenderWindow window(VideoMode(1400, 800), "Game Title", Style::Titlebar | Style::Close);
-    window.setFramerateLimit(60); //Set the framerate limit to 60fps
-    //SFML input detection
-    Event input_event;
     //Clock that records the time between each frame
     Clock delta_clock;
     //Time between each frame
     //IMPORTANT: Make sure to mutliply any movement by delta so that it is frame independant!
     Time delta;
+    Clock tick_clock;
+    //How long each tick actually took, so uneven simulation can be told apart from uneven display (F2 reports both)
+    interval_history tick_times;
+
+    //The part of the level that is on screen (anything outside it isn't drawn)
+    const FloatRect screen_area(0, 0, 1400, 800);
+
+    //Particle effects. All particle memory is allocated up front
+    particle_system particles(50000);
+
+    //Saves are written in the background. Declared after everything the game loop uses, so the last save is written before they're torn down
+    save_writer saves(profiles);
+
+    //Hot reload: edited textures, sounds and level files are picked up while the game is running
+    //Edited files are always loaded from disk, not from the asset pack
+    file_watcher watcher;
+    watcher.watch("sky.JPG");
+    for (const string& file_name : get_object_texture_files()) {
+        watcher.watch(file_name);
+    }
+    for (const string& file_name : audioFiles) {
+        watcher.watch(file_name);
+    }
+    for (int id = 1; id <= level_manager::get_level_count(); id++) {
+        watcher.watch(level_manager::get_level_file(id));
+    }
 
 
 
@@ -277,7 +441,6 @@ int main()
         //reset player forced jump if not on jump pad, otherwise force a jump
         game_object* firstObject = levels.get_current_level()->at(0);
         if (player* plyr = dynamic_cast<player*>(firstObject)) {
-            plyr->preload_player_sprites();
             plyr->update_powerups();
             if (!plyr->get_force_bounce() || plyr->get_on_down_pressed()) {
                 is_jump_pressed = false;
@@ -286,8 +449,9 @@ int main()
                 is_jump_pressed = true;
             }
             if (plyr->get_health() <= 0) {
+                renderer.stop();
                 window.close();
-                delete_save();
+                delete_save(saves, player_name, timeOn);
                 cout << "GAME OVER" << endl;
             }
         }
@@ -318,8 +482,59 @@ int main()
                 if (input_event.key.code == Keyboard::S  || input_event.key.code == Keyboard::Down) {
                     is_down_pressed = true;
                 }
+                //Rewind
+                if (input_event.key.code == Keyboard::R) {
+                    is_rewind_pressed = true;
+                }
+                //Toggle the collision debug overlay
+                if (input_event.key.code == Keyboard::F1) {
+                    show_collision_debug = !show_collision_debug;
+                }
+                //Report the current frame pacing mode and switch to the next one
+                if (input_event.key.code == Keyboard::F2) {
+                    pacing_mode mode = renderer.get_pacing_mode();
+                    print_frame_stats(mode, renderer.get_frame_stats(), tick_times.get_stats());
+                    pacing_mode next_mode = static_cast<pacing_mode>((mode + 1) % pacing_mode_count);
+                    renderer.set_pacing_mode(next_mode);
+                    tick_times.clear();
+                    cout << "Frame pacing: " << frame_pacer::get_mode_name(next_mode) << endl;
+                }
+                //Report how long collision detection has been taking and switch broadphase
+                if (input_event.key.code == Keyboard::F3) {
+                    bool using_sweep = levels.get_broadphase() == broadphase_sweep_and_prune;
+                    if (collision_ticks > 0) {
+                        cout << (using_sweep ? "Sweep and prune" : "Brute force") << ": " << collision_time.asMicroseconds() / (float)collision_ticks << "us per tick over " << collision_ticks << " ticks" << endl;
+                    }
+                    levels.set_broadphase(using_sweep ? broadphase_brute_force : broadphase_sweep_and_prune);
+                    collision_time = Time::Zero;
+                    collision_ticks = 0;
+                }
+                //Quick save/quick load
+                if (input_event.key.code == Keyboard::F5) {
+                    Clock snapshot_clock;
+                    quick_save = levels.capture_snapshot();
+                    cout << "Quick saved level " << quick_save.level_id << " (" << quick_save.data.size() << " bytes, " << snapshot_clock.getElapsedTime().asMicroseconds() << "us)" << endl;
+                }
+                if (input_event.key.code == Keyboard::F9) {
+                    Clock snapshot_clock;
+                    if (levels.restore_snapshot(quick_save)) {
+                        particles.clear();
+                        cout << "Quick loaded level " << quick_save.level_id << " (" << snapshot_clock.getElapsedTime().asMicroseconds() << "us)" << endl;
+                    }
+                    else
+                        cout << "No quick save for this version of the level" << endl;
+                }
 
             }
+            //With the collision overlay on, clicking an object prints what it is (mouse picking) and whether the player can see it
+            else if (input_event.type == Event::MouseButtonPressed && show_collision_debug) {
+                Vector2f mouse_position(input_event.mouseButton.x, input_event.mouseButton.y);
+                if (game_object* picked = levels.pick_object(mouse_position)) {
+                    cout << picked->get_type() << " at " << picked->get_x_position() << ", " << picked->get_y_position()
+                        << " (" << picked->get_width() << "x" << picked->get_height() << ")"
+                        << (levels.has_line_of_sight(picked) ? ", in sight of the player" : ", hidden from the player") << endl;
+                }
+            }
             //Check if inputs are released 
             else if (input_event.type == Event::KeyReleased) {
                 
@@ -335,6 +550,9 @@ int main()
                     is_down_pressed = false;
 
                 }
+                if (input_event.key.code == Keyboard::R) {
+                    is_rewind_pressed = false;
+                }
                 //Jump
                 if (input_event.key.code == Keyboard::W || input_event.key.code == Keyboard::Space || input_event.key.code == Keyboard::Up) {
                     if (levels.get_current_level()->at(0)) {
@@ -366,8 +584,9 @@ int main()
                 int seconds = static_cast<int>(elapsed.asSeconds()); //sets it in seconds
                 timeOn += seconds;
 
-                saveData(player_name, levelHere, timeOn);
+                saveData(saves, player_name, levelHere, timeOn, dynamic_cast<player*>(levels.get_current_level()->at(0)));
 
+                renderer.stop();
                 window.close();
             }
         }
@@ -378,32 +597,94 @@ int main()
 
         //Main game logic
 
-        //Run the update function for every object in the current level
-        levels.update_all_objects(delta, is_left_pressed, is_right_pressed, is_jump_pressed, is_down_pressed);
+        //Holding R runs time backwards instead of playing (see rewind_buffer.h)
+        //Particles aren't part of the level's state, so any on screen would be from the wrong time
+        if (is_rewind_pressed && rewind.step_back(levels)) {
+            particles.clear();
+        }
+        else {
+            //Run the update function for every object in the current level
+            levels.update_all_objects(delta, is_left_pressed, is_right_pressed, is_jump_pressed, is_down_pressed);
+
+            //Check for collisions between all objects
+            Clock collision_clock;
+            levels.detect_collisions(delta);
+            collision_time += collision_clock.getElapsedTime();
+            collision_ticks++;
+
+            //Spawn effects for anything that happened this tick
+            for (const level_event& event : levels.get_events()) {
+                switch (event.type) {
+                case event_enemy_killed:
+                    particles.emit(event.position, 60, Color(255, 120, 40), 400, 0.8f);
+                    break;
+                case event_pickup_collected:
+                    particles.emit(event.position, 40, Color(120, 255, 120), 250, 0.6f);
+                    break;
+                case event_player_jumped:
+                    particles.emit(event.position, 12, Color::White, 120, 0.3f);
+                    break;
+                }
+            }
+            levels.get_events().clear();
+            particles.update(delta.asMicroseconds() / 1'000'000.0f, &jobs);
+
+            //Switch level now that nothing is using the old one (the next level has usually been prefetched already)
+            if (levels.apply_level_switch()) {
+                //Bursts from the old level don't carry over into the new one
+                particles.clear();
+                //Autosave at the start of each level (unless the game is already closing, which has saved)
+                if (window.isOpen()) {
+                    int play_time = timeOn + static_cast<int>(clock.getElapsedTime().asSeconds());
+                    saveData(saves, player_name, levels.get_current_level_id(), play_time, dynamic_cast<player*>(levels.get_current_level()->at(0)));
+                }
+            }
 
-        //Check for collisions between all objects
-        levels.detect_collisions(delta);
+            //Remember this tick so it can be rewound to
+            rewind.record(levels);
+        }
+
+        //Reload anything that was edited since last tick
+        for (const string& file_name : watcher.poll()) {
+            int level_id = level_manager::get_level_id(file_name);
+            if (level_id > 0) {
+                levels.reload_level(level_id);
+                particles.clear();
+            }
+            else if (file_name.size() > 4 && file_name.compare(file_name.size() - 4, 4, ".wav") == 0) {
+                if (assets.reload_sound(file_name, watcher.get_disk_path(file_name)))
+                    cout << "Reloaded " << file_name << endl;
+            }
+            else {
+                //Uploaded on the render thread, so it shows up within a frame or two
+                assets.load_texture(file_name, watcher.get_disk_path(file_name));
+                cout << "Reloading " << file_name << endl;
+            }
+        }
 
         //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 
 
 
         //Render
-        //Clear the previous frame and color the background with light blue
-        window.clear();
-        window.draw(background_sprite);
-        //Draw every object in the level
-        for (auto obj : *levels.get_current_level()) {
-            window.draw(obj->get_shape());
-            window.draw(obj->get_sprite());
+        //Build this tick's draw list and hand it to the render thread
+        levels.build_draw_list(renderer.get_write_buffer(), show_collision_debug, screen_area);
+        particles.build_vertices(renderer.get_write_buffer().particles);
+        renderer.publish();
+
+        //Wait out the rest of the tick. Rendering no longer paces the loop, the render thread does its own waiting
+        Time tick_time = tick_clock.restart();
+        if (tick_time < tick_length) {
+            sleep(tick_length - tick_time);
         }
-
-        //Display the new frame
-        window.display();
+        tick_clock.restart();
 
         //Returns the time elapsed from the last restart (time between each frame)
         delta = delta_clock.restart();
+        tick_times.add(delta.asMicroseconds() / 1000.0);
     }
+    print_frame_stats(renderer.get_pacing_mode(), renderer.get_frame_stats(), tick_times.get_stats());
+    renderer.stop();
 
     //Delete the level arrays
     levels.delete_levels();
@@ -0,0 +1,389 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+//SFML files
+#include "SFML/Graphics.hpp"
+//SFML namespace
+using namespace sf;
+
+//Closest object hit by a ray
+struct raycast_hit {
+    bool hit = false;
+    int object = -1;
+    float fraction = 1; //How far along the ray the hit is (0 = start, 1 = end)
+};
+
+//Dynamic bounding volume hierarchy (AABB tree). A general spatial index for a level's objects
+//Leaves store a "fat" box (the object's bounds grown by a margin) so objects can move a little without the tree changing.
+//When an object leaves its fat box it is removed and reinserted, refitting the boxes above it and rebalancing with rotations
+class aabb_tree {
+private:
+    struct node {
+        FloatRect box; //Fat box for leaves, box around both children otherwise
+        FloatRect object_box; //The object's actual bounds (leaves only)
+        int parent = -1; //Also the next free node when the node is on the free list
+        int left = -1;
+        int right = -1;
+        int height = 0; //0 for leaves, -1 for free nodes
+        int object = -1; //The object a leaf belongs to
+    };
+
+    vector<node> nodes;
+    int root = -1;
+    int free_list = -1;
+    float margin = 8; //How far the fat boxes extend past the object's bounds
+
+    bool is_leaf(int index) const { return nodes[index].left == -1; }
+
+    static FloatRect combine(const FloatRect& a, const FloatRect& b) {
+        float left = min(a.left, b.left);
+        float top = min(a.top, b.top);
+        float right = max(a.left + a.width, b.left + b.width);
+        float bottom = max(a.top + a.height, b.top + b.height);
+        return FloatRect(left, top, right - left, bottom - top);
+    }
+    static float perimeter(const FloatRect& box) {
+        return 2 * (box.width + box.height);
+    }
+    static bool contains(const FloatRect& outer, const FloatRect& inner) {
+        return outer.left <= inner.left && outer.top <= inner.top
+            && outer.left + outer.width >= inner.left + inner.width && outer.top + outer.height >= inner.top + inner.height;
+    }
+    FloatRect fatten(const FloatRect& box) const {
+        return FloatRect(box.left - margin, box.top - margin, box.width + 2 * margin, box.height + 2 * margin);
+    }
+
+    int allocate_node() {
+        if (free_list == -1) {
+            nodes.push_back(node());
+            return (int)nodes.size() - 1;
+        }
+        int index = free_list;
+        free_list = nodes[index].parent;
+        nodes[index] = node();
+        return index;
+    }
+    void free_node(int index) {
+        nodes[index].parent = free_list;
+        nodes[index].height = -1;
+        free_list = index;
+    }
+
+    //Walk from a node up to the root, rebalancing and refitting every box on the way
+    void refit_from(int index) {
+        while (index != -1) {
+            index = balance(index);
+            int left = nodes[index].left;
+            int right = nodes[index].right;
+            nodes[index].height = 1 + max(nodes[left].height, nodes[right].height);
+            nodes[index].box = combine(nodes[left].box, nodes[right].box);
+            index = nodes[index].parent;
+        }
+    }
+
+    void insert_leaf(int leaf) {
+        if (root == -1) {
+            root = leaf;
+            nodes[root].parent = -1;
+            return;
+        }
+
+        //Find the best sibling for the new leaf, going down whichever side grows the least
+        FloatRect leaf_box = nodes[leaf].box;
+        int index = root;
+        while (!is_leaf(index)) {
+            int left = nodes[index].left;
+            int right = nodes[index].right;
+
+            float area = perimeter(nodes[index].box);
+            float combined_area = perimeter(combine(nodes[index].box, leaf_box));
+            //Cost of making a new parent for this node and the leaf
+            float cost = 2 * combined_area;
+            //Minimum cost of pushing the leaf further down
+            float inheritance_cost = 2 * (combined_area - area);
+
+            float left_cost = perimeter(combine(leaf_box, nodes[left].box)) + inheritance_cost;
+            if (!is_leaf(left))
+                left_cost -= perimeter(nodes[left].box);
+            float right_cost = perimeter(combine(leaf_box, nodes[right].box)) + inheritance_cost;
+            if (!is_leaf(right))
+                right_cost -= perimeter(nodes[right].box);
+
+            if (cost < left_cost && cost < right_cost)
+                break;
+            index = left_cost < right_cost ? left : right;
+        }
+        int sibling = index;
+
+        //Make a new parent for the sibling and the leaf
+        int old_parent = nodes[sibling].parent;
+        int new_parent = allocate_node();
+        nodes[new_parent].parent = old_parent;
+        nodes[new_parent].box = combine(leaf_box, nodes[sibling].box);
+        nodes[new_parent].height = nodes[sibling].height + 1;
+        nodes[new_parent].left = sibling;
+        nodes[new_parent].right = leaf;
+        nodes[sibling].parent = new_parent;
+        nodes[leaf].parent = new_parent;
+
+        if (old_parent == -1) {
+            root = new_parent;
+        }
+        else if (nodes[old_parent].left == sibling) {
+            nodes[old_parent].left = new_parent;
+        }
+        else {
+            nodes[old_parent].right = new_parent;
+        }
+
+        refit_from(nodes[leaf].parent);
+    }
+
+    void remove_leaf(int leaf) {
+        if (leaf == root) {
+            root = -1;
+            return;
+        }
+
+        int parent = nodes[leaf].parent;
+        int grandparent = nodes[parent].parent;
+        int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+        //The sibling takes the parent's place
+        if (grandparent == -1) {
+            root = sibling;
+            nodes[sibling].parent = -1;
+            free_node(parent);
+            return;
+        }
+        if (nodes[grandparent].left == parent) {
+            nodes[grandparent].left = sibling;
+        }
+        else {
+            nodes[grandparent].right = sibling;
+        }
+        nodes[sibling].parent = grandparent;
+        free_node(parent);
+
+        refit_from(grandparent);
+    }
+
+    //If one child of a node is more than one level taller than the other, rotate it up. Returns the node now in its place
+    int balance(int a) {
+        if (is_leaf(a) || nodes[a].height < 2)
+            return a;
+
+        int b = nodes[a].left;
+        int c = nodes[a].right;
+        int height_difference = nodes[c].height - nodes[b].height;
+
+        //Rotate c up
+        if (height_difference > 1) {
+            int f = nodes[c].left;
+            int g = nodes[c].right;
+
+            nodes[c].left = a;
+            nodes[c].parent = nodes[a].parent;
+            nodes[a].parent = c;
+            replace_child(nodes[c].parent, a, c);
+
+            //The taller of c's children stays on c, the other one moves to a
+            if (nodes[f].height > nodes[g].height) {
+                nodes[c].right = f;
+                nodes[a].right = g;
+                nodes[g].parent = a;
+                nodes[a].box = combine(nodes[b].box, nodes[g].box);
+                nodes[c].box = combine(nodes[a].box, nodes[f].box);
+                nodes[a].height = 1 + max(nodes[b].height, nodes[g].height);
+                nodes[c].height = 1 + max(nodes[a].height, nodes[f].height);
+            }
+            else {
+                nodes[c].right = g;
+                nodes[a].right = f;
+                nodes[f].parent = a;
+                nodes[a].box = combine(nodes[b].box, nodes[f].box);
+                nodes[c].box = combine(nodes[a].box, nodes[g].box);
+                nodes[a].height = 1 + max(nodes[b].height, nodes[f].height);
+                nodes[c].height = 1 + max(nodes[a].height, nodes[g].height);
+            }
+            return c;
+        }
+
+        //Rotate b up
+        if (height_difference < -1) {
+            int d = nodes[b].left;
+            int e = nodes[b].right;
+
+            nodes[b].left = a;
+            nodes[b].parent = nodes[a].parent;
+            nodes[a].parent = b;
+            replace_child(nodes[b].parent, a, b);
+
+            if (nodes[d].height > nodes[e].height) {
+                nodes[b].right = d;
+                nodes[a].left = e;
+                nodes[e].parent = a;
+                nodes[a].box = combine(nodes[c].box, nodes[e].box);
+                nodes[b].box = combine(nodes[a].box, nodes[d].box);
+                nodes[a].height = 1 + max(nodes[c].height, nodes[e].height);
+                nodes[b].height = 1 + max(nodes[a].height, nodes[d].height);
+            }
+            else {
+                nodes[b].right = e;
+                nodes[a].left = d;
+                nodes[d].parent = a;
+                nodes[a].box = combine(nodes[c].box, nodes[d].box);
+                nodes[b].box = combine(nodes[a].box, nodes[e].box);
+                nodes[a].height = 1 + max(nodes[c].height, nodes[d].height);
+                nodes[b].height = 1 + max(nodes[a].height, nodes[e].height);
+            }
+            return b;
+        }
+
+        return a;
+    }
+
+    //Point a parent (or the root) that used to hold old_child at new_child
+    void replace_child(int parent, int old_child, int new_child) {
+        if (parent == -1) {
+            root = new_child;
+        }
+        else if (nodes[parent].left == old_child) {
+            nodes[parent].left = new_child;
+        }
+        else {
+            nodes[parent].right = new_child;
+        }
+    }
+
+    //Where a segment enters a box, as a fraction of the segment. Returns -1 if it misses within max_fraction
+    static float segment_enters_box(Vector2f from, Vector2f direction, const FloatRect& box, float max_fraction) {
+        float enter = 0;
+        float exit = max_fraction;
+        float starts[2] = { from.x, from.y };
+        float directions[2] = { direction.x, direction.y };
+        float mins[2] = { box.left, box.top };
+        float maxes[2] = { box.left + box.width, box.top + box.height };
+
+        for (int axis = 0; axis < 2; axis++) {
+            if (fabs(directions[axis]) < 1e-6f) {
+                //Parallel to this axis, so it has to start between the sides
+                if (starts[axis] < mins[axis] || starts[axis] > maxes[axis])
+                    return -1;
+                continue;
+            }
+            float near_fraction = (mins[axis] - starts[axis]) / directions[axis];
+            float far_fraction = (maxes[axis] - starts[axis]) / directions[axis];
+            if (near_fraction > far_fraction)
+                swap(near_fraction, far_fraction);
+            enter = max(enter, near_fraction);
+            exit = min(exit, far_fraction);
+            if (enter > exit)
+                return -1;
+        }
+        return enter;
+    }
+
+public:
+    //Constructor (default)
+    aabb_tree() = default;
+
+    //Add an object to the tree. Returns its proxy id, used to move or remove it later
+    int insert(int object, const FloatRect& bounds) {
+        int leaf = allocate_node();
+        nodes[leaf].object = object;
+        nodes[leaf].object_box = bounds;
+        nodes[leaf].box = fatten(bounds);
+        nodes[leaf].height = 0;
+        insert_leaf(leaf);
+        return leaf;
+    }
+
+    void remove(int proxy) {
+        remove_leaf(proxy);
+        free_node(proxy);
+    }
+
+    //Update an object's bounds. The tree only changes if the object has left its fat box (including being teleported away)
+    //Returns true if the object had to be reinserted
+    bool move(int proxy, const FloatRect& bounds) {
+        nodes[proxy].object_box = bounds;
+        if (contains(nodes[proxy].box, bounds))
+            return false;
+
+        remove_leaf(proxy);
+        nodes[proxy].box = fatten(bounds);
+        insert_leaf(proxy);
+        return true;
+    }
+
+    //Call callback(object) for every object whose bounds overlap an area. Return false from the callback to stop early
+    template <typename callback_type>
+    void query(const FloatRect& area, callback_type callback) {
+        if (root == -1) return;
+
+        vector<int> stack;
+        stack.push_back(root);
+        while (!stack.empty()) {
+            int index = stack.back();
+            stack.pop_back();
+            if (!nodes[index].box.intersects(area))
+                continue;
+
+            if (is_leaf(index)) {
+                if (nodes[index].object_box.intersects(area) && !callback(nodes[index].object))
+                    return;
+            }
+            else {
+                stack.push_back(nodes[index].left);
+                stack.push_back(nodes[index].right);
+            }
+        }
+    }
+
+    //Find the closest object along the segment from -> to that callback(object) accepts (return false to ignore an object)
+    template <typename callback_type>
+    raycast_hit raycast(Vector2f from, Vector2f to, callback_type callback) {
+        raycast_hit closest;
+        if (root == -1) return closest;
+
+        Vector2f direction = to - from;
+        vector<int> stack;
+        stack.push_back(root);
+        while (!stack.empty()) {
+            int index = stack.back();
+            stack.pop_back();
+            //Skip anything further away than the closest hit so far
+            if (segment_enters_box(from, direction, nodes[index].box, closest.fraction) < 0)
+                continue;
+
+            if (is_leaf(index)) {
+                float fraction = segment_enters_box(from, direction, nodes[index].object_box, closest.fraction);
+                if (fraction >= 0 && (!closest.hit || fraction < closest.fraction) && callback(nodes[index].object)) {
+                    closest.hit = true;
+                    closest.object = nodes[index].object;
+                    closest.fraction = fraction;
+                }
+            }
+            else {
+                stack.push_back(nodes[index].left);
+                stack.push_back(nodes[index].right);
+            }
+        }
+        return closest;
+    }
+
+    //Remove everything
+    void clear() {
+        nodes.clear();
+        root = -1;
+        free_list = -1;
+    }
+
+    //Getters
+    int get_height() { return root == -1 ? 0 : nodes[root].height; }
+    const FloatRect& get_fat_box(int proxy) { return nodes[proxy].box; }
+};
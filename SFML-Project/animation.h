@@ -0,0 +1,119 @@
+#pragma once
+#include <vector>
+using namespace std;
+
+//SFML files
+#include "SFML/Graphics.hpp"
+//SFML namespace
+using namespace sf;
+
+//Size of one frame on a sprite sheet. All of the game's art is drawn on a 16x16 grid
+const int sprite_frame_size = 16;
+
+//The animations an object can play. Each one is a row on the object's sprite sheet
+//Sheets can hold several variants of the same animations (the player's health), each one anim_count rows below the last
+enum animation_id {
+    anim_idle, //Row 0
+    anim_run, //Row 1 (also used for enemy walk/fly cycles)
+    anim_jump, //Row 2
+    anim_count
+};
+
+//How one row of a sprite sheet is played
+struct animation_clip {
+    int frame_count; //Frames in the row (clamped to however many the sheet actually has)
+    float frame_time; //Seconds each frame is shown for
+};
+
+//Clip settings for every animation, indexed by animation_id
+const animation_clip animation_clips[anim_count] = {
+    { 4, 0.15f }, //Idle
+    { 6, 0.08f }, //Run
+    { 2, 0.10f }, //Jump
+};
+
+//Playback state of one animated sprite. Kept small so the whole array is walked in one tight loop
+struct animation_state {
+    Sprite* sprite; //The sprite whose texture rect is being animated
+    int columns; //Frames per row on the sprite sheet
+    int rows; //Rows on the sprite sheet
+    int animation; //The animation currently playing
+    int variant; //Which set of rows the animation is played from
+    int frame; //The frame currently shown
+    float time; //Time spent on the current frame
+};
+
+//Advances every animated sprite in the current level. Sprites with a single frame texture are never added,
+//so the cost is proportional to the number of animated sprites, not the number of objects
+class animation_system {
+private:
+    vector<animation_state> animations;
+
+    //Point the sprite at the state's current frame. Sheets without a row fall back to the first variant, then to the first row
+    void apply_frame(animation_state& state) {
+        int row = state.variant * anim_count + state.animation;
+        if (row >= state.rows)
+            row = state.animation < state.rows ? state.animation : 0;
+        state.sprite->setTextureRect(IntRect(state.frame * sprite_frame_size, row * sprite_frame_size, sprite_frame_size, sprite_frame_size));
+    }
+
+public:
+    //Constructor (default)
+    animation_system() = default;
+
+    //Start animating a sprite. Returns the animation's handle, or -1 if its texture only has one frame
+    int add(Sprite& sprite) {
+        const Texture* texture = sprite.getTexture();
+        if (!texture)
+            return -1;
+
+        int columns = texture->getSize().x / sprite_frame_size;
+        int rows = texture->getSize().y / sprite_frame_size;
+        if (columns <= 1 && rows <= 1)
+            return -1;
+
+        animation_state state = { &sprite, columns, rows, anim_idle, 0, 0, 0 };
+        apply_frame(state);
+        animations.push_back(state);
+        return (int)animations.size() - 1;
+    }
+
+    //Switch an animated sprite to another animation. Does nothing if it's already playing
+    //Changing only the variant keeps the current frame, so the animation carries on where it was
+    void play(int handle, animation_id animation, int variant = 0) {
+        animation_state& state = animations[handle];
+        if (state.animation == animation && state.variant == variant)
+            return;
+        if (state.animation != animation) {
+            state.animation = animation;
+            state.frame = 0;
+            state.time = 0;
+        }
+        state.variant = variant;
+        apply_frame(state);
+    }
+
+    //Advance every animation by delta seconds
+    void update(float delta) {
+        for (animation_state& state : animations) {
+            const animation_clip& clip = animation_clips[state.animation];
+            state.time += delta;
+            if (state.time < clip.frame_time)
+                continue;
+
+            int frame_count = clip.frame_count < state.columns ? clip.frame_count : state.columns;
+            while (state.time >= clip.frame_time) {
+                state.time -= clip.frame_time;
+                state.frame = (state.frame + 1) % frame_count;
+            }
+            apply_frame(state);
+        }
+    }
+
+    //Stop animating everything (called when the level changes)
+    void clear() {
+        animations.clear();
+    }
+
+    int get_animation_count() { return (int)animations.size(); }
+};
@@ -0,0 +1,198 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <cstdint>
+#include <cstring>
+using namespace std;
+
+//SFML files
+#include "SFML/Graphics.hpp"
+#include "SFML/Audio.hpp"
+//SFML namespace
+using namespace sf;
+
+//Our files
+#include "asset_pack.h"
+
+//Cooked assets are already decoded, so loading one is just handing SFML the bytes (no JPEG/PNG decoding or WAV parsing at runtime)
+//Cooked image: "RGBA", width (u32), height (u32), padding (u32), then width * height RGBA pixels
+//Cooked sound: "PCM1", channel count (u32), sample rate (u32), padding (u32), sample count (u64), then 16 bit samples
+//Headers are multiples of 8 bytes so the pixels/samples stay aligned inside the pack. Fields are in the machine's byte order (little endian on everything we ship on)
+const size_t cooked_image_header_size = 16;
+const size_t cooked_sound_header_size = 24;
+
+//A cooked image, pointing into the cooked bytes
+struct cooked_image {
+    unsigned int width = 0;
+    unsigned int height = 0;
+    const Uint8* pixels = nullptr;
+};
+
+//A cooked sound, pointing into the cooked bytes
+struct cooked_sound {
+    unsigned int channel_count = 0;
+    unsigned int sample_rate = 0;
+    Uint64 sample_count = 0;
+    const Int16* samples = nullptr;
+};
+
+//64 bit FNV-1a hash, used to tell whether a source file has changed since it was cooked
+inline uint64_t fnv1a_hash(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline bool read_cooked_image(const void* data, size_t size, cooked_image& out) {
+    const char* bytes = static_cast<const char*>(data);
+    if (size < cooked_image_header_size || memcmp(bytes, "RGBA", 4) != 0)
+        return false;
+    uint32_t width, height;
+    memcpy(&width, bytes + 4, 4);
+    memcpy(&height, bytes + 8, 4);
+    if ((size - cooked_image_header_size) / 4 / (width ? width : 1) < height)
+        return false;
+    out.width = width;
+    out.height = height;
+    out.pixels = reinterpret_cast<const Uint8*>(bytes + cooked_image_header_size);
+    return true;
+}
+
+inline bool read_cooked_sound(const void* data, size_t size, cooked_sound& out) {
+    const char* bytes = static_cast<const char*>(data);
+    if (size < cooked_sound_header_size || memcmp(bytes, "PCM1", 4) != 0)
+        return false;
+    uint32_t channel_count, sample_rate;
+    uint64_t sample_count;
+    memcpy(&channel_count, bytes + 4, 4);
+    memcpy(&sample_rate, bytes + 8, 4);
+    memcpy(&sample_count, bytes + 16, 8);
+    if ((size - cooked_sound_header_size) / sizeof(Int16) < sample_count)
+        return false;
+    out.channel_count = channel_count;
+    out.sample_rate = sample_rate;
+    out.sample_count = sample_count;
+    out.samples = reinterpret_cast<const Int16*>(bytes + cooked_sound_header_size);
+    return true;
+}
+
+//Turns source assets into cooked pack entries. Run offline with --build-pack, never while playing
+class asset_cooker {
+private:
+    static void write_header_value(vector<char>& out, size_t position, const void* value, size_t size) {
+        memcpy(out.data() + position, value, size);
+    }
+
+    static bool has_extension(const string& file_name, const string& extension) {
+        if (file_name.size() < extension.size())
+            return false;
+        for (size_t i = 0; i < extension.size(); i++) {
+            if (tolower((unsigned char)file_name[file_name.size() - extension.size() + i]) != extension[i])
+                return false;
+        }
+        return true;
+    }
+
+public:
+    static vector<char> cook_image(const Image& image) {
+        Vector2u size = image.getSize();
+        size_t pixel_bytes = (size_t)size.x * size.y * 4;
+        vector<char> out(cooked_image_header_size + pixel_bytes, 0);
+        memcpy(out.data(), "RGBA", 4);
+        uint32_t width = size.x, height = size.y;
+        write_header_value(out, 4, &width, 4);
+        write_header_value(out, 8, &height, 4);
+        if (pixel_bytes > 0)
+            memcpy(out.data() + cooked_image_header_size, image.getPixelsPtr(), pixel_bytes);
+        return out;
+    }
+
+    static vector<char> cook_sound(const SoundBuffer& buffer) {
+        size_t sample_bytes = (size_t)buffer.getSampleCount() * sizeof(Int16);
+        vector<char> out(cooked_sound_header_size + sample_bytes, 0);
+        memcpy(out.data(), "PCM1", 4);
+        uint32_t channel_count = buffer.getChannelCount(), sample_rate = buffer.getSampleRate();
+        uint64_t sample_count = buffer.getSampleCount();
+        write_header_value(out, 4, &channel_count, 4);
+        write_header_value(out, 8, &sample_rate, 4);
+        write_header_value(out, 16, &sample_count, 8);
+        if (sample_bytes > 0)
+            memcpy(out.data() + cooked_sound_header_size, buffer.getSamples(), sample_bytes);
+        return out;
+    }
+
+    //Cooks one source file. Images and sounds are decoded, anything else is packed as it is
+    static bool cook(const string& file_name, const vector<char>& source, pack_input& out) {
+        out.name = file_name;
+        out.source_hash = fnv1a_hash(source.data(), source.size());
+        if (has_extension(file_name, ".png") || has_extension(file_name, ".jpg")) {
+            Image image;
+            if (!image.loadFromMemory(source.data(), source.size()))
+                return false;
+            out.data = cook_image(image);
+            out.flags = pack_entry_cooked_image;
+        }
+        else if (has_extension(file_name, ".wav")) {
+            SoundBuffer buffer;
+            if (!buffer.loadFromMemory(source.data(), source.size()))
+                return false;
+            out.data = cook_sound(buffer);
+            out.flags = pack_entry_cooked_sound;
+        }
+        else {
+            out.data = source;
+            out.flags = 0;
+        }
+        return true;
+    }
+
+    //Cooks files into an asset pack. Files that haven't changed since the existing pack was built are reused instead of decoded again
+    //reused_count (if given) is set to how many were reused
+    static bool cook_pack(const string& pack_path, const vector<string>& files, int* reused_count = nullptr) {
+        vector<pack_input> inputs;
+        int reused = 0;
+        {
+            asset_pack previous;
+            previous.open(pack_path);
+            for (const string& file_name : files) {
+                ifstream reader(file_name, ios::binary);
+                if (!reader.is_open()) {
+                    cout << "Error reading " << file_name << " for the asset pack" << endl;
+                    return false;
+                }
+                vector<char> source((istreambuf_iterator<char>(reader)), istreambuf_iterator<char>());
+                uint64_t source_hash = fnv1a_hash(source.data(), source.size());
+
+                pack_input input;
+                const pack_entry* cooked = previous.find(file_name);
+                const void* data = nullptr;
+                size_t size = 0;
+                vector<char> storage;
+                if (cooked && cooked->source_hash == source_hash && previous.read(file_name, data, size, storage)) {
+                    input.name = file_name;
+                    input.source_hash = source_hash;
+                    input.flags = cooked->flags & ~pack_entry_lz4;
+                    input.data.assign(static_cast<const char*>(data), static_cast<const char*>(data) + size);
+                    cout << file_name << ": unchanged" << endl;
+                    reused++;
+                }
+                else if (!cook(file_name, source, input)) {
+                    cout << "Error cooking " << file_name << endl;
+                    return false;
+                }
+                inputs.push_back(move(input));
+            }
+            //The old pack is unmapped here, before it's overwritten
+        }
+        if (reused_count)
+            *reused_count = reused;
+        return asset_pack::build(pack_path, inputs);
+    }
+};
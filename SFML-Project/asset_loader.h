@@ -0,0 +1,188 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <map>
+#include <memory>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <functional>
+using namespace std;
+
+//SFML files
+#include "SFML/Graphics.hpp"
+#include "SFML/Audio.hpp"
+//SFML namespace
+using namespace sf;
+
+//Our files
+#include "job_system.h"
+#include "render_thread.h"
+#include "texture_cache.h"
+#include "asset_pack.h"
+#include "asset_cooker.h"
+
+//A loading asset. The asset itself is owned by whoever it was loaded into (the texture cache or the loader)
+template <typename T>
+class asset_handle {
+private:
+    T* asset = nullptr;
+    shared_future<bool> loaded; //Becomes true once the asset is usable, false if it failed to load
+public:
+    //Constructors
+    asset_handle() = default;
+    asset_handle(T* asset, shared_future<bool> loaded) : asset(asset), loaded(loaded) {}
+
+    //Whether loading has finished (successfully or not). Never blocks
+    bool is_ready() { return loaded.valid() && loaded.wait_for(chrono::seconds(0)) == future_status::ready; }
+    //Whether the asset loaded. Blocks until loading has finished
+    bool succeeded() { return loaded.get(); }
+    //The asset. Blocks until loading has finished
+    T& get() {
+        loaded.wait();
+        return *asset;
+    }
+};
+
+//A decoded texture waiting to be uploaded on the render thread
+struct texture_upload {
+    Image image; //Decoded from a source image file
+    vector<char> storage; //Decompressed cooked entry
+    cooked_image cooked; //Cooked pixels (straight out of the pack or out of storage). Used instead of image if set
+
+    bool upload(Texture& texture) {
+        if (!cooked.pixels)
+            return texture.loadFromImage(image);
+        if (!texture.create(cooked.width, cooked.height))
+            return false;
+        texture.update(cooked.pixels);
+        return true;
+    }
+};
+
+//Loads assets in the background so the game never sits on a disk read
+//Assets come from the asset pack if there is one and it has them, otherwise from loose files
+//Files are read and decoded on the job system. Textures are then uploaded to the GPU on the render thread, which owns the OpenGL context
+class asset_loader {
+private:
+    job_system& jobs;
+    render_thread& renderer;
+    job_counter decoding; //Decode jobs that haven't finished
+    const asset_pack* pack = nullptr;
+
+    map<string, SoundBuffer> sound_buffers; //Sounds are owned by the loader
+
+    atomic<int> requested{ 0 };
+    atomic<int> finished{ 0 };
+    int reported = -1; //Progress last passed to the callback
+    function<void(int, int)> progress_callback;
+
+    //Gets a texture ready to upload. Cooked pack entries are used as they are, anything else is decoded
+    //disk_path is given when reloading a file that was edited, so the new version is read from disk instead of the one in the pack
+    bool decode(texture_upload& upload, const string& file_name, const string& disk_path = "") {
+        const void* data = nullptr;
+        size_t size = 0;
+        uint32_t flags = 0;
+        if (disk_path.empty() && pack && pack->read(file_name, data, size, upload.storage, &flags)) {
+            if (flags & pack_entry_cooked_image)
+                return read_cooked_image(data, size, upload.cooked);
+            return upload.image.loadFromMemory(data, size);
+        }
+        return upload.image.loadFromFile(disk_path.empty() ? file_name : disk_path);
+    }
+
+    //Loads a sound. Cooked pack entries are handed to SFML as samples, anything else is decoded
+    bool decode(SoundBuffer& buffer, const string& file_name) {
+        const void* data = nullptr;
+        size_t size = 0;
+        uint32_t flags = 0;
+        vector<char> storage;
+        if (pack && pack->read(file_name, data, size, storage, &flags)) {
+            cooked_sound cooked;
+            if (flags & pack_entry_cooked_sound)
+                return read_cooked_sound(data, size, cooked) && buffer.loadFromSamples(cooked.samples, cooked.sample_count, cooked.channel_count, cooked.sample_rate);
+            return buffer.loadFromMemory(data, size);
+        }
+        return buffer.loadFromFile(file_name);
+    }
+
+public:
+    //Constructor. The pack (if there is one) has to outlive the loader
+    asset_loader(job_system& jobs, render_thread& renderer, const asset_pack* pack = nullptr) : jobs(jobs), renderer(renderer), pack(pack) {}
+    //Destructor. Decode jobs write into the loader, so they have to finish first
+    ~asset_loader() { jobs.wait(decoding); }
+    asset_loader(const asset_loader&) = delete;
+    asset_loader& operator=(const asset_loader&) = delete;
+
+    //Starts loading a texture into the texture cache (as file_name)
+    //disk_path skips the asset pack and reads that file instead (used to reload a texture after it's been edited). Everything using the texture picks up the new one
+    asset_handle<Texture> load_texture(const string& file_name, const string& disk_path = "") {
+        Texture& texture = texture_cache::reserve_texture(file_name);
+        shared_ptr<promise<bool>> done = make_shared<promise<bool>>();
+        shared_future<bool> loaded = done->get_future().share();
+        requested++;
+
+        jobs.run([this, &texture, file_name, disk_path, done] {
+            shared_ptr<texture_upload> upload = make_shared<texture_upload>();
+            if (!decode(*upload, file_name, disk_path)) {
+                cout << "Error loading texture file: " << file_name << endl;
+                done->set_value(false);
+                finished++;
+                return;
+            }
+            //The image is decoded, now it just needs to go to the GPU
+            renderer.run_on_render_thread([this, &texture, upload, done] {
+                done->set_value(upload->upload(texture));
+                finished++;
+            });
+        }, decoding);
+
+        return asset_handle<Texture>(&texture, loaded);
+    }
+
+    //Starts loading a sound. The buffer lives as long as the loader
+    asset_handle<SoundBuffer> load_sound(const string& file_name) {
+        SoundBuffer& buffer = sound_buffers[file_name];
+        shared_ptr<promise<bool>> done = make_shared<promise<bool>>();
+        shared_future<bool> loaded = done->get_future().share();
+        requested++;
+
+        jobs.run([this, &buffer, file_name, done] {
+            bool ok = decode(buffer, file_name);
+            if (!ok)
+                cout << "Error loading sound file: " << file_name << endl;
+            done->set_value(ok);
+            finished++;
+        }, decoding);
+
+        return asset_handle<SoundBuffer>(&buffer, loaded);
+    }
+
+    //Loads a sound again from its file (at disk_path) after it's been edited. Runs on the main thread (a sound buffer can't change while it's being decoded into)
+    //Sounds that are playing the buffer are stopped by SFML and carry on with the new one
+    bool reload_sound(const string& file_name, const string& disk_path) {
+        auto found = sound_buffers.find(file_name);
+        if (found == sound_buffers.end())
+            return false;
+        if (!found->second.loadFromFile(disk_path)) {
+            cout << "Error reloading sound file: " << disk_path << endl;
+            return false;
+        }
+        return true;
+    }
+
+    //Calls the progress callback if anything has finished loading since the last poll. Call once per tick on the main thread
+    void poll() {
+        int finished_now = finished;
+        if (finished_now != reported && progress_callback)
+            progress_callback(finished_now, requested);
+        reported = finished_now;
+    }
+
+    //Getters
+    bool is_done() { return finished == requested; }
+    float get_progress() { return requested == 0 ? 1 : finished / (float)requested; }
+    //Setters
+    //Called from poll() with (assets finished, assets requested)
+    void set_progress_callback(function<void(int, int)> callback) { progress_callback = callback; }
+};
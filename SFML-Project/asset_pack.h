@@ -0,0 +1,216 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <iterator>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+using namespace std;
+
+//Our files
+#include "mapped_file.h"
+#include "lz4_codec.h"
+
+//Entry flags
+enum pack_entry_flag {
+    pack_entry_lz4 = 1 << 0, //Stored as an LZ4 block (see lz4_codec.h)
+    pack_entry_cooked_image = 1 << 1, //Raw RGBA pixels (see asset_cooker.h)
+    pack_entry_cooked_sound = 1 << 2 //Raw 16 bit PCM samples (see asset_cooker.h)
+};
+
+//Where a file is in the pack
+struct pack_entry {
+    uint64_t offset = 0; //From the start of the pack
+    uint64_t stored_size = 0;
+    uint64_t original_size = 0;
+    uint32_t flags = 0;
+    uint64_t source_hash = 0; //Hash of the source file the entry was made from (lets the cooker skip unchanged files)
+};
+
+//A file to put in a pack
+struct pack_input {
+    string name;
+    vector<char> data; //Uncompressed, the pack decides whether to compress it
+    uint32_t flags = 0; //Any pack_entry_flag except pack_entry_lz4
+    uint64_t source_hash = 0;
+};
+
+//Every asset in one file, memory mapped so loading an asset doesn't open or copy anything
+//Layout (little endian):
+//  header: "SPAK", version (u32), entry count (u32)
+//  index:  per entry: name length (u16), name, offset (u64), stored size (u64), original size (u64), flags (u32), source hash (u64)
+//  data:   the entries' bytes, each starting on a 16 byte boundary so cooked samples can be used in place
+//Names are stored lower case, so lookups match however the code spells the file (sky.JPG, platform.PNG, ...)
+class asset_pack {
+private:
+    mapped_file file;
+    map<string, pack_entry> entries;
+
+    static const uint32_t version = 2;
+    static const uint64_t entry_alignment = 16;
+
+    static string normalize_name(string name) {
+        for (char& c : name) {
+            c = (char)tolower((unsigned char)c);
+        }
+        return name;
+    }
+
+    //Little endian helpers
+    template <typename T>
+    static void write_value(vector<char>& out, T value) {
+        for (size_t i = 0; i < sizeof(T); i++) {
+            out.push_back((char)((value >> (8 * i)) & 0xFF));
+        }
+    }
+    template <typename T>
+    static bool read_value(const char* data, size_t size, size_t& position, T& value) {
+        if (size - position < sizeof(T))
+            return false;
+        value = 0;
+        for (size_t i = 0; i < sizeof(T); i++) {
+            value |= (T)(unsigned char)data[position + i] << (8 * i);
+        }
+        position += sizeof(T);
+        return true;
+    }
+
+public:
+    //Maps a pack and reads its index. Returns false if there's no pack or it's damaged
+    bool open(const string& path) {
+        entries.clear();
+        if (!file.open(path))
+            return false;
+
+        const char* data = file.get_data();
+        size_t size = file.get_size();
+        size_t position = 4;
+        uint32_t file_version = 0, entry_count = 0;
+        if (size < 12 || memcmp(data, "SPAK", 4) != 0 || !read_value(data, size, position, file_version) || file_version != version
+            || !read_value(data, size, position, entry_count)) {
+            cout << "Error reading asset pack: " << path << endl;
+            file.close();
+            return false;
+        }
+
+        for (uint32_t i = 0; i < entry_count; i++) {
+            uint16_t name_length = 0;
+            pack_entry entry;
+            bool ok = read_value(data, size, position, name_length) && size - position >= name_length;
+            string name = ok ? string(data + position, name_length) : string();
+            position += ok ? name_length : 0;
+            ok = ok && read_value(data, size, position, entry.offset) && read_value(data, size, position, entry.stored_size)
+                && read_value(data, size, position, entry.original_size) && read_value(data, size, position, entry.flags)
+                && read_value(data, size, position, entry.source_hash)
+                && entry.offset <= size && entry.stored_size <= size - entry.offset;
+            if (!ok) {
+                cout << "Error reading asset pack: " << path << endl;
+                entries.clear();
+                file.close();
+                return false;
+            }
+            entries[name] = entry;
+        }
+        return true;
+    }
+
+    bool is_open() const { return file.get_data() != nullptr; }
+    bool contains(const string& name) const { return entries.count(normalize_name(name)) > 0; }
+
+    //The bytes of an asset. Uncompressed entries point straight into the mapped pack, compressed ones are decompressed into storage
+    //Safe to call from several threads at once
+    //flags (if given) is set to the entry's pack_entry_flags
+    bool read(const string& name, const void*& data, size_t& size, vector<char>& storage, uint32_t* flags = nullptr) const {
+        auto found = entries.find(normalize_name(name));
+        if (found == entries.end())
+            return false;
+        const pack_entry& entry = found->second;
+        if (flags)
+            *flags = entry.flags;
+        const char* stored = file.get_data() + entry.offset;
+        if (!(entry.flags & pack_entry_lz4)) {
+            data = stored;
+            size = (size_t)entry.stored_size;
+            return true;
+        }
+        storage.resize((size_t)entry.original_size);
+        if (!lz4_decompress(stored, (size_t)entry.stored_size, storage.data(), storage.size())) {
+            cout << "Error decompressing " << name << " from the asset pack" << endl;
+            return false;
+        }
+        data = storage.data();
+        size = storage.size();
+        return true;
+    }
+
+    //The index entry for an asset (nullptr if it isn't in the pack)
+    const pack_entry* find(const string& name) const {
+        auto found = entries.find(normalize_name(name));
+        return found == entries.end() ? nullptr : &found->second;
+    }
+
+    //Writes a new asset pack. Each entry is compressed if that makes it at least 10% smaller
+    static bool build(const string& pack_path, const vector<pack_input>& inputs) {
+        vector<vector<char>> contents;
+        vector<pack_entry> packed;
+        for (const pack_input& input : inputs) {
+            vector<char> compressed = lz4_compress(input.data.data(), input.data.size());
+            pack_entry entry;
+            entry.original_size = input.data.size();
+            entry.flags = input.flags;
+            entry.source_hash = input.source_hash;
+            if (compressed.size() < input.data.size() - input.data.size() / 10) {
+                entry.flags |= pack_entry_lz4;
+                contents.push_back(move(compressed));
+            }
+            else {
+                contents.push_back(input.data);
+            }
+            entry.stored_size = contents.back().size();
+            packed.push_back(entry);
+        }
+
+        //The data starts straight after the index
+        uint64_t offset = 12;
+        for (const pack_input& input : inputs) {
+            offset += 2 + input.name.size() + 8 + 8 + 8 + 4 + 8;
+        }
+        vector<uint64_t> padding;
+        vector<char> index;
+        index.insert(index.end(), { 'S', 'P', 'A', 'K' });
+        write_value<uint32_t>(index, version);
+        write_value<uint32_t>(index, (uint32_t)inputs.size());
+        for (size_t i = 0; i < inputs.size(); i++) {
+            string name = normalize_name(inputs[i].name);
+            padding.push_back((entry_alignment - offset % entry_alignment) % entry_alignment);
+            offset += padding[i];
+            packed[i].offset = offset;
+            offset += packed[i].stored_size;
+            write_value<uint16_t>(index, (uint16_t)name.size());
+            index.insert(index.end(), name.begin(), name.end());
+            write_value<uint64_t>(index, packed[i].offset);
+            write_value<uint64_t>(index, packed[i].stored_size);
+            write_value<uint64_t>(index, packed[i].original_size);
+            write_value<uint32_t>(index, packed[i].flags);
+            write_value<uint64_t>(index, packed[i].source_hash);
+        }
+
+        ofstream writer(pack_path, ios::binary | ios::trunc);
+        if (!writer.is_open()) {
+            cout << "Error writing asset pack: " << pack_path << endl;
+            return false;
+        }
+        writer.write(index.data(), index.size());
+        const char zeros[entry_alignment] = {};
+        for (size_t i = 0; i < contents.size(); i++) {
+            writer.write(zeros, padding[i]);
+            writer.write(contents[i].data(), contents[i].size());
+            cout << inputs[i].name << ": " << packed[i].original_size << " -> " << packed[i].stored_size << " bytes"
+                << (packed[i].flags & pack_entry_lz4 ? " (lz4)" : "") << endl;
+        }
+        return writer.good();
+    }
+};
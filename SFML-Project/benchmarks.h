@@ -0,0 +1,687 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <limits>
+#include <atomic>
+#include <thread>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <cstdio>
+using namespace std;
+
+//SFML files
+#include "SFML/Graphics.hpp"
+#include "SFML/System.hpp"
+#include "SFML/Audio.hpp"
+//SFML namespace
+using namespace sf;
+
+//Our files
+#include "particle_system.h"
+#include "level_manager.h"
+#include "contact_solver.h"
+#include "asset_pack.h"
+#include "asset_cooker.h"
+#include "rewind_buffer.h"
+
+//Benchmarks and self checks, run from the command line instead of the game (see main)
+//Each one prints what it measured and returns false if a check failed or a budget was missed
+
+//Average and worst time of a number of runs of something, in milliseconds
+struct bench_timing {
+    float average = 0;
+    float longest = 0;
+};
+template <typename F>
+bench_timing time_runs(int runs, F func) {
+    bench_timing timing;
+    Clock clock;
+    for (int run = 0; run < runs; run++) {
+        clock.restart();
+        func();
+        float run_time = clock.getElapsedTime().asMicroseconds() / 1000.0f;
+        timing.average += run_time / runs;
+        timing.longest = max(timing.longest, run_time);
+    }
+    return timing;
+}
+inline void print_timing(const string& name, bench_timing timing) {
+    cout << "  " << name << ": average " << timing.average << "ms, longest " << timing.longest << "ms" << endl;
+}
+
+//Particles: a full buffer (50k) has to update and build its vertices in under 2ms, and a handful of particles shouldn't cost a full buffer's work
+inline bool bench_particles(job_system& jobs) {
+    const int capacity = 50000;
+    const float budget = 2; //Milliseconds per tick
+    const float delta = 1.0f / 60.0f;
+    particle_system particles(capacity);
+    VertexArray quads(Quads);
+
+    cout << "Particles (" << jobs.get_thread_count() << " worker threads)" << endl;
+    //Long lived so none of them die during the run
+    particles.emit(Vector2f(700, 400), capacity, Color::White, 400, 1000);
+    bench_timing serial = time_runs(300, [&] { particles.update(delta); });
+    bench_timing parallel = time_runs(300, [&] { particles.update(delta, &jobs); });
+    bench_timing drawing = time_runs(60, [&] { quads.clear(); particles.build_vertices(quads); });
+    print_timing("update 50k (one thread)", serial);
+    print_timing("update 50k (job system)", parallel);
+    print_timing("build vertices 50k", drawing);
+
+    particles.clear();
+    particles.emit(Vector2f(700, 400), 12, Color::White, 120, 1000);
+    bench_timing few = time_runs(300, [&] { particles.update(delta, &jobs); });
+    print_timing("update 12", few);
+
+    //A tick's particle work is the update plus building their vertices for the render thread
+    float tick_cost = parallel.average + drawing.average;
+    bool passed = tick_cost <= budget && particles.get_live_count() == 12;
+    cout << (passed ? "  PASS" : "  FAIL") << ": 50k particles cost " << tick_cost << "ms a tick (budget " << budget << "ms)" << endl;
+    return passed;
+}
+
+//A made up level of about count objects of mixed sizes for the collision benchmarks: platforms of every length, walls, small pickups,
+//and enemies patrolling along the platforms (the movers). The player stands on its own platform out of the way. The same count always makes the same level
+inline vector<game_object*> build_synthetic_level(int count) {
+    vector<game_object*> objects;
+    minstd_rand random(count);
+    uniform_real_distribution<float> platform_length(150, 650);
+    objects.push_back(new player(25, 0, 50, 50, "Player", Color::Transparent));
+    objects.push_back(new game_object(0, 100, 100, 50, "Platform", Color::Black));
+
+    //A grid of cells, each a platform with an enemy walking or flying along it, and sometimes a pickup in its way or a wall at its end
+    const float cell_width = 700, cell_height = 250;
+    const int columns = 40;
+    for (int cell = 0; (int)objects.size() < count; cell++) {
+        float x = 200 + (cell % columns) * cell_width;
+        float y = 300 + (cell / columns) * cell_height;
+        float length = platform_length(random);
+        int travel_distance = (int)(length - 50) / 2;
+        float speed = (float)(50 + random() % 250) * (random() % 2 ? 1 : -1);
+        objects.push_back(new game_object(x, y, length, 40, "Platform", Color::Black));
+        if (random() % 2)
+            objects.push_back(new ground_enemy(x + length / 2 - 25, y - 50, 50, 50, "Enemy", Color::Transparent, speed, travel_distance, false));
+        else
+            objects.push_back(new flying_enemy(x + length / 2 - 25, y - 60, 50, 50, "Enemy", Color::Transparent, speed, travel_distance, false));
+        if (random() % 3 == 0)
+            objects.push_back(new health_pickup(x + 10 + (float)(random() % 100), y - 40, 30, 30, "Pickup", Color::Transparent));
+        if (random() % 4 == 0)
+            objects.push_back(new game_object(x + length - 30, y - 200, 30, 240, "Platform", Color::Black));
+    }
+    return objects;
+}
+
+//Plays a level for a number of ticks, timing detect_collisions() and recording where every object was after each tick
+inline bench_timing run_collisions(level_manager& levels, int ticks, vector<float>& positions) {
+    const Time delta = seconds(1.0f / 60.0f);
+    bench_timing timing;
+    Clock clock;
+    positions.clear();
+    for (int tick = 0; tick < ticks; tick++) {
+        levels.update_all_objects(delta, false, false, false, false);
+        clock.restart();
+        levels.detect_collisions(delta);
+        float tick_time = clock.getElapsedTime().asMicroseconds() / 1000.0f;
+        timing.average += tick_time / ticks;
+        timing.longest = max(timing.longest, tick_time);
+        for (game_object* obj : *levels.get_current_level()) {
+            positions.push_back(obj->get_x_position());
+            positions.push_back(obj->get_y_position());
+        }
+        levels.get_events().clear();
+    }
+    return timing;
+}
+
+//Both broadphases on the same level, each played from the start on its own level manager
+//Every contact changes where something ends up, so they have to leave every object in exactly the same place every tick
+template <typename F>
+bool bench_broadphase_level(const string& name, int ticks, F start_level) {
+    level_manager brute_force_levels, sweep_levels;
+    start_level(brute_force_levels);
+    start_level(sweep_levels);
+    vector<float> brute_force_positions, sweep_positions;
+    brute_force_levels.set_broadphase(broadphase_brute_force);
+    sweep_levels.set_broadphase(broadphase_sweep_and_prune);
+    bench_timing brute_force = run_collisions(brute_force_levels, ticks, brute_force_positions);
+    bench_timing sweep = run_collisions(sweep_levels, ticks, sweep_positions);
+
+    cout << name << " (" << sweep_levels.get_current_level()->size() << " objects)" << endl;
+    print_timing("brute force", brute_force);
+    print_timing("sweep and prune", sweep);
+    bool passed = brute_force_positions == sweep_positions;
+    if (!passed)
+        cout << "  FAIL: the broadphases played the level differently" << endl;
+    brute_force_levels.delete_levels();
+    sweep_levels.delete_levels();
+    return passed;
+}
+
+//Broadphases: brute force against sweep and prune on every level and on made up levels much bigger than them
+//Times detect_collisions() the same way the F3 stats do
+inline bool bench_broadphase() {
+    const int ticks = 120;
+    const int synthetic_sizes[] = { 250, 1000, 4000 };
+    bool passed = true;
+    cout << "Broadphases (" << ticks << " ticks each)" << endl;
+    for (int level_id = 1; level_id <= level_manager::get_level_count(); level_id++) {
+        passed = bench_broadphase_level("Level " + to_string(level_id), ticks, [level_id](level_manager& levels) {
+            levels.set_current_level(level_id);
+        }) && passed;
+    }
+    for (int size : synthetic_sizes) {
+        passed = bench_broadphase_level("Made up level", ticks, [size](level_manager& levels) {
+            levels.set_custom_level(level_manager::get_level_count() + 1, build_synthetic_level(size));
+        }) && passed;
+    }
+    cout << (passed ? "  PASS" : "  FAIL") << ": both broadphases played every level the same" << endl;
+    return passed;
+}
+
+//One contact solver check: a body moving against some solids, and where it has to end up and what it has to be touching there
+struct solver_check {
+    string name;
+    FloatRect start;
+    Vector2f motion;
+    vector<solid_box> solids;
+    Vector2f expected_position;
+    contact_state expected_state;
+};
+
+inline contact_state make_contact_state(bool grounded, bool on_ceiling, bool wall_left, bool wall_right) {
+    contact_state state;
+    state.grounded = grounded;
+    state.on_ceiling = on_ceiling;
+    state.wall_left = wall_left;
+    state.wall_right = wall_right;
+    return state;
+}
+
+//The contact solver's cases: movement resolved x then y, the grounded/wall/ceiling flags, and the corners in between
+inline vector<solver_check> get_solver_checks() {
+    const solid_box floor = { FloatRect(0, 750, 250, 50), 0 };
+    const solid_box next_floor = { FloatRect(250, 750, 250, 50), 1 }; //Lines up with floor, like two platforms side by side
+    const solid_box wall = { FloatRect(300, 600, 20, 150), 2 }; //Standing on next_floor
+    const solid_box ceiling = { FloatRect(0, 500, 250, 50), 3 };
+    const FloatRect on_floor(100, 700, 50, 50);
+    return {
+        { "landing", FloatRect(100, 690, 50, 50), Vector2f(0, 15), { floor }, Vector2f(100, 700), make_contact_state(true, false, false, false) },
+        { "resting", on_floor, Vector2f(0, 0), { floor }, Vector2f(100, 700), make_contact_state(true, false, false, false) },
+        { "falling past", FloatRect(300, 600, 50, 50), Vector2f(0, 15), { floor }, Vector2f(300, 615), make_contact_state(false, false, false, false) },
+        { "head on ceiling", FloatRect(100, 560, 50, 50), Vector2f(0, -20), { ceiling }, Vector2f(100, 550), make_contact_state(false, true, false, false) },
+        { "walking into a wall", FloatRect(240, 700, 50, 50), Vector2f(20, 0), { next_floor, wall }, Vector2f(250, 700), make_contact_state(true, false, false, true) },
+        { "backing into a wall", FloatRect(330, 700, 50, 50), Vector2f(-20, 0), { next_floor, wall }, Vector2f(320, 700), make_contact_state(true, false, true, false) },
+        //x is resolved first, so gravity pulling the body into the floor never stops it walking
+        { "walking while falling into the floor", on_floor, Vector2f(5, 5), { floor }, Vector2f(105, 700), make_contact_state(true, false, false, false) },
+        //Crossing the seam between two floors mustn't catch on the second floor's side
+        { "walking over a seam", FloatRect(220, 700, 50, 50), Vector2f(10, 5), { floor, next_floor }, Vector2f(230, 700), make_contact_state(true, false, false, false) },
+        //Moving diagonally into the corner between a floor and a wall is stopped on both axes
+        { "into a corner", FloatRect(235, 690, 50, 50), Vector2f(25, 20), { next_floor, wall }, Vector2f(250, 700), make_contact_state(true, false, false, true) },
+        //Coming down onto the top corner of a wall: x is moved first while the body is still above it, so it lands on top instead of being pushed off sideways
+        { "landing on a wall's corner", FloatRect(240, 540, 50, 50), Vector2f(20, 20), { next_floor, wall }, Vector2f(260, 550), make_contact_state(true, false, false, false) },
+        { "sliding down a wall onto the floor", FloatRect(325, 690, 50, 50), Vector2f(-10, 20), { next_floor, wall }, Vector2f(320, 700), make_contact_state(true, false, true, false) },
+        //Corners only touching, or a body hanging less than the skin width over an edge, doesn't count as standing or a wall
+        { "corner to corner", FloatRect(200, 700, 50, 50), Vector2f(0, 0), { { FloatRect(250, 750, 50, 50), 0 } }, Vector2f(200, 700), make_contact_state(false, false, false, false) },
+        { "barely over an edge", FloatRect(249.75f, 700, 50, 50), Vector2f(0, 0), { floor }, Vector2f(249.75f, 700), make_contact_state(false, false, false, false) },
+        //Walking through a gap exactly its own height, touching the floor and the ceiling
+        { "in a gap its own height", on_floor, Vector2f(5, 0), { floor, { FloatRect(0, 650, 250, 50), 4 } }, Vector2f(105, 700), make_contact_state(true, true, false, false) },
+    };
+}
+
+//Contact solver: every check has to come out right, and a few thousand bodies have to be solved well inside a tick
+inline bool bench_solver() {
+    const float budget = 1; //Milliseconds for all the bodies
+    contact_solver solver;
+    vector<solver_contact> contacts;
+    bool passed = true;
+
+    cout << "Contact solver" << endl;
+    for (const solver_check& check : get_solver_checks()) {
+        solver_body body;
+        body.start = check.start;
+        body.motion = check.motion;
+        solver.solve(body, check.solids, contacts);
+        const contact_state& state = body.state;
+        const contact_state& expected = check.expected_state;
+        bool position_right = fabs(body.bounds.left - check.expected_position.x) < 0.01f && fabs(body.bounds.top - check.expected_position.y) < 0.01f;
+        bool state_right = state.grounded == expected.grounded && state.on_ceiling == expected.on_ceiling
+            && state.wall_left == expected.wall_left && state.wall_right == expected.wall_right;
+        if (!position_right || !state_right) {
+            cout << "  FAIL: " << check.name << ": ended at (" << body.bounds.left << ", " << body.bounds.top << ") grounded " << state.grounded
+                << " ceiling " << state.on_ceiling << " wall left " << state.wall_left << " wall right " << state.wall_right << endl;
+            passed = false;
+        }
+    }
+
+    //Bodies walking and falling around a field of platforms and walls, each with the solids near it (like the level manager gathers them)
+    const int body_count = 5000;
+    minstd_rand random(body_count);
+    vector<solver_body> bodies(body_count);
+    vector<vector<solid_box>> nearby(body_count);
+    for (int i = 0; i < body_count; i++) {
+        float x = (float)(i % 100) * 300, y = (float)(i / 100) * 300;
+        nearby[i] = { { FloatRect(x, y + 250, 250, 50), 0 }, { FloatRect(x + 250, y + 250, 250, 50), 1 }, { FloatRect(x + 200, y + 100, 20, 150), 2 }, { FloatRect(x, y, 250, 30), 3 } };
+        bodies[i].start = FloatRect(x + (float)(random() % 150), y + 195 + (float)(random() % 10), 50, 50);
+        bodies[i].motion = Vector2f((float)(random() % 21) - 10, (float)(random() % 21) - 10);
+    }
+    bench_timing timing = time_runs(100, [&] {
+        for (int i = 0; i < body_count; i++) {
+            solver.solve(bodies[i], nearby[i], contacts);
+        }
+    });
+    print_timing(to_string(body_count) + " bodies", timing);
+
+    passed = passed && timing.average <= budget;
+    cout << (passed ? "  PASS" : "  FAIL") << ": " << get_solver_checks().size() << " checks, " << body_count << " bodies in " << timing.average << "ms (budget " << budget << "ms)" << endl;
+    return passed;
+}
+
+//Parallel contact generation on a level, played from the start once on one thread and once split across the job system
+//(however few movers there are). The merged contacts have to come out in the same order, so every object ends up in the same place every tick
+template <typename F>
+bool bench_parallel_collisions_level(job_system& jobs, const string& name, int ticks, F start_level) {
+    level_manager serial_levels, parallel_levels;
+    serial_levels.set_job_system(&jobs);
+    parallel_levels.set_job_system(&jobs);
+    start_level(serial_levels);
+    start_level(parallel_levels);
+    serial_levels.set_parallel_collision_threshold(numeric_limits<size_t>::max());
+    parallel_levels.set_parallel_collision_threshold(0);
+    vector<float> serial_positions, parallel_positions;
+    bench_timing serial = run_collisions(serial_levels, ticks, serial_positions);
+    bench_timing parallel = run_collisions(parallel_levels, ticks, parallel_positions);
+
+    cout << name << " (" << parallel_levels.get_current_level()->size() << " objects)" << endl;
+    print_timing("one thread", serial);
+    print_timing("job system", parallel);
+    bool passed = serial_positions == parallel_positions;
+    if (!passed)
+        cout << "  FAIL: the merged contacts didn't play the level the same as one thread" << endl;
+    serial_levels.delete_levels();
+    parallel_levels.delete_levels();
+    return passed;
+}
+
+//Collisions: contact generation forced onto the job system on every level and on made up levels with thousands of movers
+inline bool bench_parallel_collisions(job_system& jobs) {
+    const int ticks = 120;
+    const int synthetic_sizes[] = { 250, 1000, 4000 };
+    bool passed = true;
+    cout << "Parallel contact generation (" << jobs.get_thread_count() << " worker threads, " << ticks << " ticks each)" << endl;
+    for (int level_id = 1; level_id <= level_manager::get_level_count(); level_id++) {
+        passed = bench_parallel_collisions_level(jobs, "Level " + to_string(level_id), ticks, [level_id](level_manager& levels) {
+            levels.set_current_level(level_id);
+        }) && passed;
+    }
+    for (int size : synthetic_sizes) {
+        passed = bench_parallel_collisions_level(jobs, "Made up level", ticks, [size](level_manager& levels) {
+            levels.set_custom_level(level_manager::get_level_count() + 1, build_synthetic_level(size));
+        }) && passed;
+    }
+    cout << (passed ? "  PASS" : "  FAIL") << ": parallel contacts played every level the same as one thread" << endl;
+    return passed;
+}
+
+//Job system: what it costs to start jobs, to have them stolen and to wait on them
+//Also checks every job runs exactly once and that run_after() jobs wait for what they depend on
+inline bool bench_jobs(job_system& jobs) {
+    const int job_count = 10000;
+    const int runs = 20;
+    bool passed = true;
+    cout << "Job system (" << jobs.get_thread_count() << " worker threads)" << endl;
+
+    //Spawning: empty jobs queued from this thread, then waited on
+    atomic<int> ran{ 0 };
+    bench_timing spawn = time_runs(runs, [&] {
+        job_counter counter;
+        for (int i = 0; i < job_count; i++) {
+            jobs.run([&ran] { ran++; }, counter);
+        }
+        jobs.wait(counter);
+    });
+    print_timing(to_string(job_count) + " empty jobs", spawn);
+    cout << "    " << spawn.average * 1000 / job_count << "us a job" << endl;
+    passed = passed && ran == runs * job_count;
+
+    //Stealing: one job queues the rest on its own thread's queue, so everyone else only gets them by stealing
+    ran = 0;
+    atomic<int> stolen{ 0 };
+    bench_timing steal = time_runs(runs, [&] {
+        job_counter counter;
+        jobs.run([&] {
+            thread::id spawner = this_thread::get_id();
+            for (int i = 0; i < job_count; i++) {
+                jobs.run([&ran, &stolen, spawner] {
+                    ran++;
+                    if (this_thread::get_id() != spawner)
+                        stolen++;
+                }, counter);
+            }
+        }, counter);
+        jobs.wait(counter);
+    });
+    print_timing(to_string(job_count) + " jobs queued by one job", steal);
+    cout << "    " << steal.average * 1000 / job_count << "us a job, " << stolen * 100.0f / max((int)ran, 1) << "% stolen" << endl;
+    passed = passed && ran == runs * job_count;
+
+    //parallel_for: the cost of splitting a tick's work into chunks when the chunks themselves do nothing
+    const size_t chunks = 64, chunk_size = 16;
+    atomic<size_t> covered{ 0 };
+    bench_timing split = time_runs(1000, [&] {
+        jobs.parallel_for(chunks * chunk_size, chunk_size, [&covered](size_t first, size_t last) { covered += last - first; });
+    });
+    print_timing("parallel_for over " + to_string(chunks) + " empty chunks", split);
+    passed = passed && covered == 1000 * chunks * chunk_size;
+
+    //Waiting: how long after a job finishes the thread waiting on it carries on
+    float latency = 0, longest_latency = 0;
+    for (int run = 0; run < runs; run++) {
+        Clock clock;
+        atomic<Int64> finished_at{ 0 };
+        job_counter counter;
+        jobs.run([&] {
+            sleep(milliseconds(2));
+            finished_at = clock.getElapsedTime().asMicroseconds();
+        }, counter);
+        jobs.wait(counter);
+        float run_latency = (clock.getElapsedTime().asMicroseconds() - finished_at) / 1000.0f;
+        latency += run_latency / runs;
+        longest_latency = max(longest_latency, run_latency);
+    }
+    cout << "  waking up after a 2ms job: average " << latency << "ms, longest " << longest_latency << "ms" << endl;
+
+    //Continuations only start once everything they depend on has finished
+    for (int run = 0; run < runs; run++) {
+        job_counter dependencies, continuation;
+        atomic<int> finished{ 0 };
+        int finished_before = -1;
+        for (int i = 0; i < 100; i++) {
+            jobs.run([&finished] { finished++; }, dependencies);
+        }
+        jobs.run_after(dependencies, [&] { finished_before = finished; }, continuation);
+        jobs.wait(continuation);
+        passed = passed && finished_before == 100;
+    }
+
+    cout << (passed ? "  PASS" : "  FAIL") << ": every job ran once, continuations ran after their dependencies" << endl;
+    return passed;
+}
+
+//The level a level's end goal leads to (0 if it has none)
+inline int get_next_level_id(level_manager& levels) {
+    for (game_object* obj : *levels.get_current_level()) {
+        if (end_goal* goal = dynamic_cast<end_goal*>(obj))
+            return goal->get_level_to_load();
+    }
+    return 0;
+}
+
+//Level transitions: how long switching to the level an end goal leads to stalls the tick, with the level built on the spot
+//and with it prefetched on the job system while the level before it was being played
+inline bool bench_transitions(job_system& jobs) {
+    const float budget = 2; //Milliseconds a switch to a prefetched level may take
+    bench_timing built, prefetched;
+    int switches = 0;
+    cout << "Level transitions (" << jobs.get_thread_count() << " worker threads)" << endl;
+    for (int level_id = 1; level_id < level_manager::get_level_count(); level_id++) {
+        level_manager built_levels, prefetched_levels;
+        prefetched_levels.set_job_system(&jobs);
+        built_levels.set_current_level(level_id);
+        prefetched_levels.set_current_level(level_id);
+        int next_level_id = get_next_level_id(prefetched_levels);
+        //Give the prefetch the time a player would spend on the level before it
+        sleep(milliseconds(100));
+
+        Clock clock;
+        built_levels.set_current_level(next_level_id);
+        float built_time = clock.restart().asMicroseconds() / 1000.0f;
+        prefetched_levels.set_current_level(next_level_id);
+        float prefetched_time = clock.getElapsedTime().asMicroseconds() / 1000.0f;
+        built.average += built_time;
+        built.longest = max(built.longest, built_time);
+        prefetched.average += prefetched_time;
+        prefetched.longest = max(prefetched.longest, prefetched_time);
+        switches++;
+
+        built_levels.delete_levels();
+        prefetched_levels.delete_levels();
+    }
+    built.average /= switches;
+    prefetched.average /= switches;
+    print_timing("built on the switch", built);
+    print_timing("prefetched", prefetched);
+
+    bool passed = prefetched.longest <= budget;
+    cout << (passed ? "  PASS" : "  FAIL") << ": " << switches << " switches, longest " << prefetched.longest << "ms (budget " << budget << "ms)" << endl;
+    return passed;
+}
+
+//A whole file's bytes. Returns false if it can't be read
+inline bool read_file_bytes(const string& path, vector<char>& bytes) {
+    ifstream reader(path, ios::binary);
+    if (!reader.is_open())
+        return false;
+    bytes.assign(istreambuf_iterator<char>(reader), istreambuf_iterator<char>());
+    return true;
+}
+
+//Gets an asset ready the way the asset loader does: cooked pack entries are used as they are, anything else is decoded
+//Textures stop short of the GPU upload, which needs the render thread
+inline bool decode_asset(const string& file_name, const asset_pack* pack) {
+    const void* data = nullptr;
+    size_t size = 0;
+    uint32_t flags = 0;
+    vector<char> storage;
+    if (pack && pack->read(file_name, data, size, storage, &flags)) {
+        if (flags & pack_entry_cooked_image) {
+            cooked_image cooked;
+            return read_cooked_image(data, size, cooked);
+        }
+        if (flags & pack_entry_cooked_sound) {
+            cooked_sound cooked;
+            SoundBuffer buffer;
+            return read_cooked_sound(data, size, cooked) && buffer.loadFromSamples(cooked.samples, cooked.sample_count, cooked.channel_count, cooked.sample_rate);
+        }
+    }
+    string extension = file_name.substr(file_name.find_last_of('.') + 1);
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (extension == "wav") {
+        SoundBuffer buffer;
+        return buffer.loadFromFile(file_name);
+    }
+    Image image;
+    return image.loadFromFile(file_name);
+}
+
+//Asset pack: every cooked asset through LZ4 and back, a pack cooked from them, mapped and read back, cooked again reusing every entry,
+//and loading every asset from the pack timed against loading it from its loose file
+inline bool bench_assets(const vector<string>& files) {
+    const string pack_path = "bench_assets.pak";
+    const int runs = 5;
+    bool passed = true;
+    cout << "Asset pack (" << files.size() << " files)" << endl;
+
+    //Cooking and LZ4: every cooked asset has to come back byte for byte
+    vector<vector<char>> cooked;
+    size_t cooked_bytes = 0, compressed_bytes = 0;
+    float cook_time = 0, compress_time = 0, decompress_time = 0;
+    for (const string& file_name : files) {
+        vector<char> source;
+        pack_input input;
+        Clock clock;
+        if (!read_file_bytes(file_name, source) || !asset_cooker::cook(file_name, source, input)) {
+            cout << "  FAIL: couldn't cook " << file_name << endl;
+            return false;
+        }
+        cook_time += clock.restart().asMicroseconds() / 1000.0f;
+        vector<char> compressed = lz4_compress(input.data.data(), input.data.size());
+        compress_time += clock.restart().asMicroseconds() / 1000.0f;
+        vector<char> decompressed(input.data.size());
+        bool round_trip = lz4_decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()) && decompressed == input.data;
+        decompress_time += clock.getElapsedTime().asMicroseconds() / 1000.0f;
+        if (!round_trip)
+            cout << "  FAIL: cooked " << file_name << " didn't come back the same through LZ4" << endl;
+        passed = passed && round_trip;
+        cooked_bytes += input.data.size();
+        compressed_bytes += compressed.size();
+        cooked.push_back(move(input.data));
+    }
+    cout << "  cooked in " << cook_time << "ms" << endl;
+    cout << "  LZ4: " << cooked_bytes << " -> " << compressed_bytes << " bytes, compressed in " << compress_time << "ms, decompressed in " << decompress_time << "ms" << endl;
+
+    //Pack: cooked from scratch, mapped, and every entry read back as it was cooked
+    remove(pack_path.c_str());
+    Clock clock;
+    if (!asset_cooker::cook_pack(pack_path, files)) {
+        cout << "  FAIL: couldn't cook " << pack_path << endl;
+        return false;
+    }
+    cout << "  cooked the pack in " << clock.getElapsedTime().asMicroseconds() / 1000.0f << "ms" << endl;
+    {
+        asset_pack pack;
+        if (!pack.open(pack_path)) {
+            cout << "  FAIL: couldn't map " << pack_path << endl;
+            passed = false;
+        }
+        for (size_t i = 0; i < files.size() && pack.is_open(); i++) {
+            const void* data = nullptr;
+            size_t size = 0;
+            vector<char> storage;
+            bool same = pack.read(files[i], data, size, storage) && size == cooked[i].size() && memcmp(data, cooked[i].data(), size) == 0;
+            if (!same)
+                cout << "  FAIL: " << files[i] << " didn't read back out of the pack as it was cooked" << endl;
+            passed = passed && same;
+        }
+    }
+
+    //Cooking again: nothing has changed, so every entry has to be reused rather than decoded again
+    int reused = 0;
+    clock.restart();
+    bool recooked = asset_cooker::cook_pack(pack_path, files, &reused);
+    cout << "  cooked the pack again in " << clock.getElapsedTime().asMicroseconds() / 1000.0f << "ms, " << reused << " entries reused" << endl;
+    if (!recooked || reused != (int)files.size()) {
+        cout << "  FAIL: unchanged files were cooked again" << endl;
+        passed = false;
+    }
+
+    //Loading: every asset out of the mapped pack against from its loose file
+    {
+        asset_pack pack;
+        pack.open(pack_path);
+        bool loaded = true;
+        bench_timing loose = time_runs(runs, [&] {
+            for (const string& file_name : files) {
+                loaded = decode_asset(file_name, nullptr) && loaded;
+            }
+        });
+        bench_timing packed = time_runs(runs, [&] {
+            for (const string& file_name : files) {
+                loaded = decode_asset(file_name, &pack) && loaded;
+            }
+        });
+        print_timing("loading loose files", loose);
+        print_timing("loading from the pack", packed);
+        if (!loaded)
+            cout << "  FAIL: not every asset loaded" << endl;
+        passed = passed && loaded;
+    }
+    remove(pack_path.c_str());
+
+    cout << (passed ? "  PASS" : "  FAIL") << ": every asset came back the same through cooking, LZ4 and the pack" << endl;
+    return passed;
+}
+
+//Rewind: made up levels of thousands of objects played at 120Hz, twice the game's tick rate
+//Every tick's delta has to decode back to exactly its snapshot, and stepping back has to put the level back exactly how each tick left it
+//Recording has to average a small part of a 120Hz tick (8ms), and stepping back a tick can't cost more than playing one
+inline bool bench_rewind() {
+    const int ticks = 600;
+    const int keyframe_interval = 60;
+    const Time delta = seconds(1.0f / 120.0f);
+    const float budget = 1; //Milliseconds a tick may spend recording, on average
+    const int synthetic_sizes[] = { 1000, 4000 };
+    bool passed = true;
+    cout << "Rewind (" << ticks << " ticks at 120Hz)" << endl;
+    for (int size : synthetic_sizes) {
+        level_manager levels;
+        levels.set_custom_level(level_manager::get_level_count() + 1, build_synthetic_level(size));
+        rewind_buffer rewind(ticks, 64 * 1024 * 1024, keyframe_interval);
+
+        //Play, recording every tick and keeping its snapshot to check against
+        vector<level_snapshot> snapshots(ticks);
+        bench_timing playing, recording;
+        Clock clock;
+        for (int tick = 0; tick < ticks; tick++) {
+            clock.restart();
+            levels.update_all_objects(delta, false, false, false, false);
+            levels.detect_collisions(delta);
+            levels.get_events().clear();
+            float play_time = clock.restart().asMicroseconds() / 1000.0f;
+            playing.average += play_time / ticks;
+            playing.longest = max(playing.longest, play_time);
+            rewind.record(levels);
+            float record_time = clock.getElapsedTime().asMicroseconds() / 1000.0f;
+            recording.average += record_time / ticks;
+            recording.longest = max(recording.longest, record_time);
+            levels.capture_snapshot(snapshots[tick]);
+        }
+
+        size_t used_bytes = rewind.get_used_bytes();
+
+        //Every snapshot through a delta against its keyframe and back
+        vector<vector<char>> deltas(ticks);
+        vector<char> decoded;
+        size_t delta_bytes = 0;
+        int round_trips = 0;
+        int tick = 0;
+        bench_timing encoding = time_runs(ticks, [&] {
+            rewind_buffer::encode_delta(snapshots[tick - tick % keyframe_interval].data, snapshots[tick].data, deltas[tick]);
+            delta_bytes += deltas[tick].size();
+            tick++;
+        });
+        tick = 0;
+        bench_timing decoding = time_runs(ticks, [&] {
+            if (rewind_buffer::decode_delta(snapshots[tick - tick % keyframe_interval].data, deltas[tick], decoded) && decoded == snapshots[tick].data)
+                round_trips++;
+            tick++;
+        });
+
+        //Back through every recorded tick, then once more at the oldest, where the level has to stay put
+        int frame_count = (int)rewind.get_frame_count();
+        int matched = 0;
+        bench_timing stepping;
+        level_snapshot restored;
+        for (int step = 1; step <= frame_count; step++) {
+            clock.restart();
+            bool stepped = rewind.step_back(levels);
+            float step_time = clock.getElapsedTime().asMicroseconds() / 1000.0f;
+            stepping.average += step_time / frame_count;
+            stepping.longest = max(stepping.longest, step_time);
+            levels.capture_snapshot(restored);
+            if (stepped && restored.data == snapshots[ticks - 1 - min(step, frame_count - 1)].data)
+                matched++;
+        }
+
+        cout << "Made up level (" << levels.get_current_level()->size() << " objects, " << snapshots[0].data.size() << " byte snapshots)" << endl;
+        print_timing("play", playing);
+        print_timing("record", recording);
+        print_timing("encode delta", encoding);
+        print_timing("decode delta", decoding);
+        print_timing("step back", stepping);
+        cout << "  deltas average " << delta_bytes / ticks << " bytes, " << used_bytes / 1024 << "KB for " << frame_count << " ticks" << endl;
+        bool level_passed = round_trips == ticks && matched == frame_count && frame_count == ticks
+            && recording.average <= budget && stepping.average <= playing.average;
+        if (round_trips != ticks)
+            cout << "  FAIL: " << ticks - round_trips << " deltas didn't decode back to their snapshot" << endl;
+        if (matched != frame_count || frame_count != ticks)
+            cout << "  FAIL: stepping back didn't put the level back how it was (" << matched << " of " << ticks << " ticks)" << endl;
+        if (recording.average > budget || stepping.average > playing.average)
+            cout << "  FAIL: recording or stepping back took too long" << endl;
+        passed = passed && level_passed;
+        levels.delete_levels();
+    }
+    cout << (passed ? "  PASS" : "  FAIL") << ": every tick rewound exactly (recording budget " << budget << "ms a tick)" << endl;
+    return passed;
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <vector>
+#include <cmath>
+using namespace std;
+
+//SFML files
+#include "SFML/Graphics.hpp"
+//SFML namespace
+using namespace sf;
+
+//What a body is touching once its contacts have been solved
+struct contact_state {
+    bool grounded = false; //Standing on something
+    bool on_ceiling = false; //Head against something
+    bool wall_left = false; //Something solid directly to the left
+    bool wall_right = false; //Something solid directly to the right
+};
+
+//A solid box the body can't move into
+struct solid_box {
+    FloatRect bounds;
+    int id; //Whatever the caller uses to identify it (the level manager uses the object's index)
+};
+
+//A solid the body ended up touching
+struct solver_contact {
+    int id; //The solid's id
+    Vector2f normal; //Points from the solid towards the body, e.g. (0, -1) when standing on it
+};
+
+//A moving body. start and motion are inputs, bounds and state are outputs
+struct solver_body {
+    FloatRect start; //Bounds at the start of the tick
+    Vector2f motion; //How far the body tried to move this tick
+    FloatRect bounds; //Where the body ends up
+    contact_state state; //What it's touching there
+};
+
+//Pushes moving bodies out of solid boxes
+//Movement is resolved one axis at a time (x then y): the body is moved along x and pushed back out of anything it
+//overlaps by the minimum translation on x, then the same is done on y. Afterwards, anything within skin_width of the
+//body's sides counts as being touched, which gives the grounded/wall/ceiling state
+class contact_solver {
+private:
+    float skin_width = 0.5f;
+
+    static float right(const FloatRect& box) { return box.left + box.width; }
+    static float bottom(const FloatRect& box) { return box.top + box.height; }
+
+    //Touching edges don't count as overlapping. The tolerance stops floating point error from a previous push
+    //making a body that's resting on something look like it's inside it
+    static bool overlaps(const FloatRect& a, const FloatRect& b) {
+        const float tolerance = 0.01f;
+        return a.left < right(b) - tolerance && b.left < right(a) - tolerance
+            && a.top < bottom(b) - tolerance && b.top < bottom(a) - tolerance;
+    }
+
+    //Minimum translation along one axis that separates two spans. The body is pushed back against its movement,
+    //or out the nearest side if it didn't move on this axis
+    static float get_separation(float body_min, float body_max, float solid_min, float solid_max, float movement) {
+        float push_back = solid_min - body_max; //Negative: back towards the minimum side
+        float push_forward = solid_max - body_min; //Positive: towards the maximum side
+        if (movement > 0)
+            return push_back;
+        if (movement < 0)
+            return push_forward;
+        return fabs(push_back) < fabs(push_forward) ? push_back : push_forward;
+    }
+
+public:
+    //Constructor (default)
+    contact_solver() = default;
+
+    //Solve one body against the solids near it. The solids touching the body afterwards are written to contacts
+    void solve(solver_body& body, const vector<solid_box>& solids, vector<solver_contact>& contacts) {
+        contacts.clear();
+        FloatRect box = body.start;
+
+        //X axis
+        box.left += body.motion.x;
+        for (const solid_box& solid : solids) {
+            if (overlaps(box, solid.bounds))
+                box.left += get_separation(box.left, right(box), solid.bounds.left, right(solid.bounds), body.motion.x);
+        }
+
+        //Y axis
+        box.top += body.motion.y;
+        for (const solid_box& solid : solids) {
+            if (overlaps(box, solid.bounds))
+                box.top += get_separation(box.top, bottom(box), solid.bounds.top, bottom(solid.bounds), body.motion.y);
+        }
+
+        //Work out what the body is touching
+        contact_state state;
+        for (const solid_box& solid : solids) {
+            const FloatRect& other = solid.bounds;
+            //How much the spans share (touching corners don't count)
+            float x_shared = min(right(box), right(other)) - max(box.left, other.left);
+            float y_shared = min(bottom(box), bottom(other)) - max(box.top, other.top);
+
+            if (x_shared > skin_width) {
+                if (fabs(bottom(box) - other.top) <= skin_width) {
+                    state.grounded = true;
+                    contacts.push_back({ solid.id, Vector2f(0, -1) });
+                }
+                else if (fabs(box.top - bottom(other)) <= skin_width) {
+                    state.on_ceiling = true;
+                    contacts.push_back({ solid.id, Vector2f(0, 1) });
+                }
+            }
+            if (y_shared > skin_width) {
+                if (fabs(right(box) - other.left) <= skin_width) {
+                    state.wall_right = true;
+                    contacts.push_back({ solid.id, Vector2f(-1, 0) });
+                }
+                else if (fabs(box.left - right(other)) <= skin_width) {
+                    state.wall_left = true;
+                    contacts.push_back({ solid.id, Vector2f(1, 0) });
+                }
+            }
+        }
+
+        body.bounds = box;
+        body.state = state;
+    }
+
+    float get_skin_width() { return skin_width; }
+};
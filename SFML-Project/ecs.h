@@ -0,0 +1,323 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <type_traits>
+using namespace std;
+
+//Entity component system
+//An entity is just a handle. What it is comes from the set of components it has, not from a class
+//Entities with exactly the same set of components share an archetype, which stores each component type in its own contiguous array,
+//so a system walking one component of every matching entity reads memory in order with no virtual calls or casts
+//Components are plain values (they're moved between archetypes with memcpy). Empty structs are tags: they take part in queries but take no memory
+
+typedef uint64_t component_mask; //One bit per component type
+const int max_component_types = 64;
+
+//Handle to an entity. Safe to keep after the entity is destroyed: its slot gets a new generation, so the old handle stops matching
+struct entity {
+    uint32_t index = 0;
+    uint32_t generation = 0; //Generations start at 1, so a default handle never matches anything
+
+    bool is_null() const { return generation == 0; }
+    bool operator==(const entity& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const entity& other) const { return !(*this == other); }
+};
+
+//Size of every component type, indexed by its id. Filled in the first time each type is used
+inline vector<size_t>& get_component_sizes() {
+    static vector<size_t> sizes;
+    return sizes;
+}
+
+//Every component type gets an id (its bit in a component_mask) the first time it's used
+//There's no bit for a type past the limit, so using one stops the game rather than letting it share (or shift past) another type's bit
+template <typename T>
+int get_component_id() {
+    static_assert(is_trivially_copyable<T>::value, "Components have to be plain values");
+    static int id = [] {
+        vector<size_t>& sizes = get_component_sizes();
+        if (sizes.size() >= max_component_types) {
+            cout << "Too many component types (the limit is " << max_component_types << ")" << endl;
+            abort();
+        }
+        sizes.push_back(is_empty<T>::value ? 0 : sizeof(T));
+        return (int)sizes.size() - 1;
+    }();
+    return id;
+}
+
+//The mask of a set of component types
+template <typename... T>
+component_mask get_component_mask() {
+    component_mask mask = 0;
+    int ids[] = { 0, get_component_id<T>()... };
+    for (size_t i = 1; i < sizeof(ids) / sizeof(ids[0]); i++) {
+        mask |= (component_mask)1 << ids[i];
+    }
+    return mask;
+}
+
+//Every entity with one exact set of components. Row i of every column belongs to entities[i]
+class archetype {
+private:
+    component_mask mask;
+    int column_of[max_component_types]; //Which column holds each component type (-1 if it isn't stored here or is a tag)
+    vector<vector<char>> columns;
+    vector<size_t> column_sizes; //Bytes per row
+    vector<entity> entities;
+
+public:
+    //Archetypes an entity moves to when one component is added or removed, filled in as they're first needed
+    archetype* add_edges[max_component_types] = {};
+    archetype* remove_edges[max_component_types] = {};
+
+    //Constructor
+    archetype(component_mask mask) : mask(mask) {
+        vector<size_t>& sizes = get_component_sizes();
+        for (int id = 0; id < max_component_types; id++) {
+            column_of[id] = -1;
+            if ((mask & ((component_mask)1 << id)) && sizes[id] > 0) {
+                column_of[id] = (int)columns.size();
+                columns.push_back(vector<char>());
+                column_sizes.push_back(sizes[id]);
+            }
+        }
+    }
+
+    //Adds a row for an entity (its components are left zeroed). Returns the row
+    size_t add_row(entity owner) {
+        for (size_t column = 0; column < columns.size(); column++) {
+            columns[column].resize(columns[column].size() + column_sizes[column]);
+        }
+        entities.push_back(owner);
+        return entities.size() - 1;
+    }
+
+    //Removes a row by moving the last row into it. Returns the entity that moved (null if it was the last row)
+    entity remove_row(size_t row) {
+        size_t last = entities.size() - 1;
+        entity moved;
+        if (row != last) {
+            for (size_t column = 0; column < columns.size(); column++) {
+                memcpy(columns[column].data() + row * column_sizes[column], columns[column].data() + last * column_sizes[column], column_sizes[column]);
+            }
+            entities[row] = entities[last];
+            moved = entities[row];
+        }
+        for (size_t column = 0; column < columns.size(); column++) {
+            columns[column].resize(columns[column].size() - column_sizes[column]);
+        }
+        entities.pop_back();
+        return moved;
+    }
+
+    //Copies every component both archetypes store from a row of another archetype
+    void copy_row(size_t row, const archetype& from, size_t from_row) {
+        for (int id = 0; id < max_component_types; id++) {
+            if (column_of[id] >= 0 && from.column_of[id] >= 0) {
+                size_t size = column_sizes[column_of[id]];
+                memcpy(columns[column_of[id]].data() + row * size, from.columns[from.column_of[id]].data() + from_row * size, size);
+            }
+        }
+    }
+
+    //The start of a component's column (nullptr for tags and components this archetype doesn't have)
+    void* get_column(int id) {
+        return column_of[id] >= 0 ? columns[column_of[id]].data() : nullptr;
+    }
+    template <typename T>
+    T* get_column() {
+        return static_cast<T*>(get_column(get_component_id<T>()));
+    }
+
+    //Getters
+    component_mask get_mask() const { return mask; }
+    size_t get_size() const { return entities.size(); }
+    const vector<entity>& get_entities() const { return entities; }
+};
+
+//Owns every entity and archetype
+class ecs_world {
+private:
+    //Where each entity slot's components live
+    struct entity_location {
+        archetype* owner = nullptr; //nullptr if the slot is free
+        size_t row = 0;
+        uint32_t generation = 0;
+    };
+
+    vector<unique_ptr<archetype>> archetypes;
+    map<component_mask, archetype*> archetypes_by_mask;
+    vector<entity_location> locations;
+    vector<uint32_t> free_slots;
+    size_t entity_count = 0;
+
+    archetype* get_archetype(component_mask mask) {
+        auto found = archetypes_by_mask.find(mask);
+        if (found != archetypes_by_mask.end())
+            return found->second;
+        archetypes.push_back(unique_ptr<archetype>(new archetype(mask)));
+        archetypes_by_mask[mask] = archetypes.back().get();
+        return archetypes.back().get();
+    }
+
+    //Takes an entity's row out of its archetype, fixing up the entity that was moved into the gap
+    void remove_from_archetype(entity_location& location) {
+        entity moved = location.owner->remove_row(location.row);
+        if (!moved.is_null())
+            locations[moved.index].row = location.row;
+    }
+
+    //Moves an entity to the archetype with one component added or removed, keeping the components they share
+    void move_entity(entity target, archetype* destination) {
+        entity_location& location = locations[target.index];
+        size_t row = destination->add_row(target);
+        destination->copy_row(row, *location.owner, location.row);
+        remove_from_archetype(location);
+        location.owner = destination;
+        location.row = row;
+    }
+
+    template <typename T>
+    void set_component(archetype* owner, size_t row, const T& value) {
+        if (T* column = owner->get_column<T>())
+            column[row] = value;
+    }
+
+    template <typename T>
+    static T* get_query_column(archetype& owner) {
+        static_assert(!is_empty<T>::value, "Tags have no data, pass them in with instead");
+        return owner.get_column<T>();
+    }
+
+    //Calls func with an archetype's entities and the start of each requested column
+    template <typename... C, typename F>
+    static void each_row(archetype& owner, F& func, C*... columns) {
+        const vector<entity>& entities = owner.get_entities();
+        for (size_t row = 0; row < entities.size(); row++) {
+            func(entities[row], columns[row]...);
+        }
+    }
+
+public:
+    //Constructor (default)
+    ecs_world() = default;
+    ecs_world(const ecs_world&) = delete;
+    ecs_world& operator=(const ecs_world&) = delete;
+
+    //Creates an entity with a set of components
+    template <typename... C>
+    entity create(const C&... components) {
+        uint32_t index;
+        if (!free_slots.empty()) {
+            index = free_slots.back();
+            free_slots.pop_back();
+        }
+        else {
+            index = (uint32_t)locations.size();
+            locations.push_back(entity_location());
+        }
+        entity_location& location = locations[index];
+        location.generation++;
+        entity created = { index, location.generation };
+
+        location.owner = get_archetype(get_component_mask<C...>());
+        location.row = location.owner->add_row(created);
+        int unused[] = { 0, (set_component(location.owner, location.row, components), 0)... };
+        (void)unused;
+        entity_count++;
+        return created;
+    }
+
+    void destroy(entity target) {
+        if (!is_alive(target))
+            return;
+        entity_location& location = locations[target.index];
+        remove_from_archetype(location);
+        location.owner = nullptr;
+        free_slots.push_back(target.index);
+        entity_count--;
+    }
+
+    //Destroys every entity. Archetypes are kept, so building the same kinds of entities again doesn't allocate
+    void clear() {
+        for (auto& owner : archetypes) {
+            while (owner->get_size() > 0) {
+                owner->remove_row(owner->get_size() - 1);
+            }
+        }
+        free_slots.clear();
+        for (uint32_t index = (uint32_t)locations.size(); index > 0; index--) {
+            locations[index - 1].owner = nullptr;
+            free_slots.push_back(index - 1);
+        }
+        entity_count = 0;
+    }
+
+    bool is_alive(entity target) const {
+        return target.index < locations.size() && locations[target.index].owner && locations[target.index].generation == target.generation;
+    }
+
+    template <typename T>
+    bool has(entity target) const {
+        return is_alive(target) && (locations[target.index].owner->get_mask() & get_component_mask<T>()) != 0;
+    }
+
+    //A component of an entity (nullptr if it doesn't have one). Only valid until components are next added or removed
+    template <typename T>
+    T* get(entity target) {
+        static_assert(!is_empty<T>::value, "Tags have no data, use has() instead");
+        if (!has<T>(target))
+            return nullptr;
+        return locations[target.index].owner->get_column<T>() + locations[target.index].row;
+    }
+
+    //Adds a component (or overwrites it if the entity already has one)
+    template <typename T>
+    void add(entity target, const T& value = T()) {
+        if (!is_alive(target))
+            return;
+        if (!has<T>(target)) {
+            int id = get_component_id<T>();
+            archetype* owner = locations[target.index].owner;
+            if (!owner->add_edges[id])
+                owner->add_edges[id] = get_archetype(owner->get_mask() | ((component_mask)1 << id));
+            move_entity(target, owner->add_edges[id]);
+        }
+        set_component(locations[target.index].owner, locations[target.index].row, value);
+    }
+
+    template <typename T>
+    void remove(entity target) {
+        if (!has<T>(target))
+            return;
+        int id = get_component_id<T>();
+        archetype* owner = locations[target.index].owner;
+        if (!owner->remove_edges[id])
+            owner->remove_edges[id] = get_archetype(owner->get_mask() & ~((component_mask)1 << id));
+        move_entity(target, owner->remove_edges[id]);
+    }
+
+    //Query: calls func(entity, C&...) for every entity that has all of C, all of with and none of without
+    //Goes archetype by archetype, so entities come out grouped by what they are rather than in the order they were created
+    //Don't create, destroy, add or remove components while a query is running
+    template <typename... C, typename F>
+    void each(F func, component_mask with = 0, component_mask without = 0) {
+        component_mask required = get_component_mask<C...>() | with;
+        for (auto& owner : archetypes) {
+            component_mask mask = owner->get_mask();
+            if ((mask & required) != required || (mask & without) != 0 || owner->get_size() == 0)
+                continue;
+            each_row<C...>(*owner, func, get_query_column<C>(*owner)...);
+        }
+    }
+
+    //Getters
+    size_t get_entity_count() const { return entity_count; }
+    size_t get_archetype_count() const { return archetypes.size(); }
+};
@@ -0,0 +1,178 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <cctype>
+using namespace std;
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <cerrno>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+//Tells us when files change on disk, so assets and levels can be reloaded without restarting the game
+//Uses inotify on Linux. Everywhere else the files' modified times are checked a couple of times a second
+//Names are matched ignoring case, like the asset pack does ("platform.PNG" in the code is platform.png on disk), and poll() gives them back
+//as they were passed to watch(). get_disk_path() gives the name the file really has, for reading it on file systems where case matters
+class file_watcher {
+private:
+    map<string, string> files; //Normalized path -> the path as it was passed to watch()
+    map<string, string> disk_paths; //Normalized path -> the path as it is on disk
+
+    //Paths are compared in lower case (see asset_pack::normalize_name)
+    static string normalize_path(string path) {
+        for (char& c : path) {
+            c = (char)tolower((unsigned char)c);
+        }
+        return path;
+    }
+
+#ifdef __linux__
+    int inotify_file = -1;
+    map<int, string> directories; //inotify watch -> the directory it's watching
+
+    //Editors often save by writing a new file and renaming it over the old one, so the directory is watched rather than the file
+    void watch_directory(const string& directory) {
+        for (const auto& watched : directories) {
+            if (watched.second == directory)
+                return;
+        }
+        int watch = inotify_add_watch(inotify_file, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (watch >= 0)
+            directories[watch] = directory;
+    }
+
+    static string join_path(const string& directory, const string& name) {
+        return directory == "." ? name : directory + "/" + name;
+    }
+
+    //The file in a directory whose name matches ignoring case (the name as given if there isn't one)
+    static string find_disk_path(const string& directory, const string& name) {
+        string wanted = normalize_path(name);
+        string found = name;
+        if (DIR* listing = opendir(directory.c_str())) {
+            while (dirent* entry = readdir(listing)) {
+                if (normalize_path(entry->d_name) == wanted) {
+                    found = entry->d_name;
+                    break;
+                }
+            }
+            closedir(listing);
+        }
+        return join_path(directory, found);
+    }
+#else
+    map<string, long long> modified_times;
+    chrono::steady_clock::time_point next_check;
+    chrono::milliseconds check_interval{ 500 };
+
+    //Seconds since the epoch the file was last written (-1 if it doesn't exist)
+    static long long get_modified_time(const string& path) {
+#ifdef _WIN32
+        struct _stat64 info;
+        if (_stat64(path.c_str(), &info) != 0)
+            return -1;
+#else
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+            return -1;
+#endif
+        return (long long)info.st_mtime;
+    }
+#endif
+
+public:
+    //Constructor
+    file_watcher() {
+#ifdef __linux__
+        inotify_file = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    }
+    //Destructor
+    ~file_watcher() {
+#ifdef __linux__
+        if (inotify_file >= 0)
+            close(inotify_file);
+#endif
+    }
+    file_watcher(const file_watcher&) = delete;
+    file_watcher& operator=(const file_watcher&) = delete;
+
+    //Starts watching a file (relative to the working directory)
+    void watch(const string& path) {
+        string normalized = normalize_path(path);
+        if (!files.insert({ normalized, path }).second)
+            return;
+#ifdef __linux__
+        size_t slash = path.find_last_of('/');
+        string directory = slash == string::npos ? "." : path.substr(0, slash);
+        disk_paths[normalized] = find_disk_path(directory, path.substr(slash == string::npos ? 0 : slash + 1));
+        if (inotify_file >= 0)
+            watch_directory(directory);
+#else
+        //Windows (and macOS by default) don't care about case, so the name works as it is
+        disk_paths[normalized] = path;
+        modified_times[path] = get_modified_time(path);
+#endif
+    }
+
+    //The path a watched file has on disk (it can differ in case from the path it was watched with)
+    string get_disk_path(const string& path) const {
+        auto found = disk_paths.find(normalize_path(path));
+        return found != disk_paths.end() ? found->second : path;
+    }
+
+    //The watched files that have changed since the last call. Never blocks, so it can be called every tick
+    vector<string> poll() {
+        vector<string> changed;
+#ifdef __linux__
+        if (inotify_file < 0)
+            return changed;
+        alignas(inotify_event) char buffer[4096];
+        while (true) {
+            ssize_t length = read(inotify_file, buffer, sizeof(buffer));
+            if (length <= 0)
+                break;
+            for (ssize_t position = 0; position < length;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + position);
+                position += sizeof(inotify_event) + event->len;
+                if (event->len == 0)
+                    continue;
+                auto directory = directories.find(event->wd);
+                if (directory == directories.end())
+                    continue;
+                string disk_path = join_path(directory->second, event->name);
+                auto file = files.find(normalize_path(disk_path));
+                if (file == files.end())
+                    continue;
+                //The file may have been saved under a different case than before
+                disk_paths[file->first] = disk_path;
+                if (find(changed.begin(), changed.end(), file->second) == changed.end())
+                    changed.push_back(file->second);
+            }
+        }
+#else
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if (now < next_check)
+            return changed;
+        next_check = now + check_interval;
+        for (auto& file : modified_times) {
+            long long modified = get_modified_time(file.first);
+            if (modified != file.second) {
+                file.second = modified;
+                if (modified >= 0)
+                    changed.push_back(file.first);
+            }
+        }
+#endif
+        return changed;
+    }
+};
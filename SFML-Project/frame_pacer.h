@@ -0,0 +1,193 @@
+#pragma once
+#include <cmath>
+using namespace std;
+
+//SFML files
+#include "SFML/Graphics.hpp"
+#include "SFML/System.hpp"
+//SFML namespace
+using namespace sf;
+
+//Ways the renderer can pace its frames
+enum pacing_mode {
+    pacing_vsync, //Let the driver wait for the monitor's vertical sync
+    pacing_precise, //Sleep most of the way to the next frame, then spin for the last bit (sleep alone is too coarse)
+    pacing_uncapped, //No waiting: every new frame from the simulation is shown as soon as it's drawn (nothing is drawn twice)
+    pacing_adaptive, //Precise limiting, but drops to 30/20 fps when frames keep taking longer than the budget
+    pacing_mode_count
+};
+
+//Frame (or tick) time statistics over the last few seconds (all in milliseconds)
+struct frame_stats {
+    double average = 0;
+    double variance = 0;
+    double standard_deviation = 0;
+    double longest = 0;
+    int frame_count = 0;
+    //How even the motion looked: each frame should show the tick after the one the frame before showed
+    int repeated_frames = 0; //Frames that showed the same tick again (the motion stopped for a frame)
+    int skipped_ticks = 0; //Ticks that were never shown (the motion jumped)
+};
+
+//Rolling window of the last few seconds of intervals (frame times or tick times)
+class interval_history {
+private:
+    static const int history_size = 240;
+    double intervals[history_size] = {};
+    int tick_steps[history_size] = {}; //How many ticks on each frame was from the one before (1 is perfect)
+    int history_count = 0;
+    int history_index = 0;
+
+public:
+    void add(double interval, int tick_step = 1) {
+        intervals[history_index] = interval;
+        tick_steps[history_index] = tick_step;
+        history_index = (history_index + 1) % history_size;
+        if (history_count < history_size)
+            history_count++;
+    }
+
+    void clear() {
+        history_count = 0;
+        history_index = 0;
+    }
+
+    //Average, variance and worst interval, and how many ticks were repeated or skipped
+    frame_stats get_stats() {
+        frame_stats stats;
+        stats.frame_count = history_count;
+        if (history_count == 0)
+            return stats;
+
+        double sum = 0;
+        for (int i = 0; i < history_count; i++) {
+            sum += intervals[i];
+            if (intervals[i] > stats.longest)
+                stats.longest = intervals[i];
+            if (tick_steps[i] == 0)
+                stats.repeated_frames++;
+            else if (tick_steps[i] > 1)
+                stats.skipped_ticks += tick_steps[i] - 1;
+        }
+        stats.average = sum / history_count;
+        double squared_difference_sum = 0;
+        for (int i = 0; i < history_count; i++) {
+            squared_difference_sum += (intervals[i] - stats.average) * (intervals[i] - stats.average);
+        }
+        stats.variance = squared_difference_sum / history_count;
+        stats.standard_deviation = sqrt(stats.variance);
+        return stats;
+    }
+};
+
+//Paces frames for the render thread and measures how even the frame times actually are
+class frame_pacer {
+private:
+    pacing_mode mode = pacing_precise;
+    Int64 target_frame_time = 1'000'000 / 60; //Microseconds per frame when limiting
+    Int64 adaptive_frame_time = 1'000'000 / 60; //Microseconds per frame picked by the adaptive mode
+    Int64 spin_margin = 2000; //Microseconds before the deadline where we stop sleeping and start spinning
+
+    Clock clock; //Never restarted, all times below are measured against it
+    Int64 next_deadline = 0; //When the next frame should be displayed
+    Int64 frame_start = 0; //When the current frame started
+    Int64 last_frame_end = 0;
+    Uint64 last_frame_tick = 0; //The simulation tick the last frame showed
+    double average_work_time = 0; //Running average of how long frames take before any waiting
+
+    interval_history frame_times;
+
+    //Block until the deadline. Sleeps while it's safe to, then spins
+    void wait_until(Int64 deadline) {
+        Int64 remaining = deadline - clock.getElapsedTime().asMicroseconds();
+        if (remaining > spin_margin) {
+            sleep(microseconds(remaining - spin_margin));
+        }
+        while (clock.getElapsedTime().asMicroseconds() < deadline) {
+            //Spin
+        }
+    }
+
+    //Pick the slowest frame rate (60, 30 or 20 fps) that the recent frames comfortably fit into
+    void update_adaptive_frame_time() {
+        const Int64 frame_rates[3] = { 60, 30, 20 };
+        for (Int64 frame_rate : frame_rates) {
+            adaptive_frame_time = 1'000'000 / frame_rate;
+            //Leave 20% headroom so we don't flip back and forth every frame
+            if (average_work_time * 1.2 < adaptive_frame_time)
+                break;
+        }
+    }
+
+public:
+    //Constructor (default)
+    frame_pacer() = default;
+
+    //Switch pacing mode and set the window up for it. Must be called on the thread that draws to the window
+    void set_mode(pacing_mode new_mode, RenderWindow& window) {
+        mode = new_mode;
+        //SFML's own limiter uses plain sleep, so it's always off. We do the limiting ourselves
+        window.setFramerateLimit(0);
+        window.setVerticalSyncEnabled(mode == pacing_vsync);
+        next_deadline = clock.getElapsedTime().asMicroseconds();
+        frame_times.clear();
+    }
+
+    //Call when the renderer starts working on a frame
+    void begin_frame() {
+        frame_start = clock.getElapsedTime().asMicroseconds();
+    }
+
+    //Call right before window.display(). Waits until it's time to show the frame
+    void wait_for_next_frame() {
+        Int64 now = clock.getElapsedTime().asMicroseconds();
+        average_work_time += ((now - frame_start) - average_work_time) * 0.05;
+
+        Int64 frame_time;
+        if (mode == pacing_precise)
+            frame_time = target_frame_time;
+        else if (mode == pacing_adaptive) {
+            update_adaptive_frame_time();
+            frame_time = adaptive_frame_time;
+        }
+        else
+            return;
+
+        next_deadline += frame_time;
+        //If we've fallen more than a frame behind, don't try to catch up with a burst of frames
+        if (next_deadline < now - frame_time)
+            next_deadline = now;
+        wait_until(next_deadline);
+    }
+
+    //Call right after window.display() with the simulation tick the frame showed. Records the frame time
+    void end_frame(Uint64 tick) {
+        Int64 now = clock.getElapsedTime().asMicroseconds();
+        if (last_frame_end > 0)
+            frame_times.add((now - last_frame_end) / 1000.0, (int)(tick - last_frame_tick));
+        last_frame_end = now;
+        last_frame_tick = tick;
+    }
+
+    //Average, variance and worst frame time over the recent frames, and how many ticks they repeated or skipped
+    frame_stats get_stats() {
+        return frame_times.get_stats();
+    }
+
+    pacing_mode get_mode() { return mode; }
+
+    static const char* get_mode_name(pacing_mode mode) {
+        switch (mode) {
+        case pacing_vsync:
+            return "VSync";
+        case pacing_precise:
+            return "Precise 60fps limit";
+        case pacing_uncapped:
+            return "Uncapped";
+        case pacing_adaptive:
+            return "Adaptive";
+        default:
+            return "Unknown";
+        }
+    }
+};
@@ -1,8 +1,18 @@
 #pragma once
 #include <iostream>
 #include <string>
+#include <map>
+#include <vector>
 using namespace std;
 
+//Our files
+#include "texture_cache.h"
+#include "animation.h"
+#include "contact_solver.h"
+#include "level_snapshot.h"
+#include "ecs.h"
+#include "level_components.h"
+
 //SFML files
 #include "SFML/Graphics.hpp"
 #include "SFML/Window.hpp"
@@ -10,13 +20,82 @@ using namespace std;
 //SFML namespace
 using namespace sf;
 
+//Every texture a game object can use. These are loaded in the background at startup so building a level never waits on the disk
+inline const vector<string>& get_object_texture_files() {
+	static const vector<string> files = {
+		"platform.PNG", "health_pickup.PNG", "speed_pickup.PNG", "jump_pad.PNG",
+		"player_sheet.png",
+		"ground_enemy.PNG", "invincible_ground_enemy.PNG", "flying_enemy.PNG", "invincible_flying_enemy.PNG",
+		"end_goal.PNG"
+	};
+	return files;
+}
+
+//Textures that are tiled across their object rather than stretched (platforms and jump pads)
+//Repeating changes the texture on the GPU, so it's set once on the render thread after loading (see main). Building a level (which can happen on a worker) only reads textures
+inline const vector<string>& get_tiled_texture_files() {
+	static const vector<string> files = { "platform.PNG", "jump_pad.PNG" };
+	return files;
+}
+
+//Visuals an object can ask the renderer to draw. Objects only get the flags for what they actually need
+enum render_flag {
+	render_none = 0,
+	render_sprite = 1 << 0, //Draw the object's sprite
+	render_shape = 1 << 1, //Draw the object's filled shape (skipped for transparent shapes)
+	render_debug_outline = 1 << 2 //Include the object's bounds in the debug collision overlay
+};
+
+//Collision layers. Every object is on one layer (picked from its type) and has a mask of the layers it interacts with
+//Two objects are only checked against each other if both of their masks include the other's layer
+enum collision_layer {
+	layer_none = 0,
+	layer_player = 1 << 0,
+	layer_ground_enemy = 1 << 1,
+	layer_flying_enemy = 1 << 2,
+	layer_platform = 1 << 3,
+	layer_pickup = 1 << 4,
+	layer_jump_pad = 1 << 5,
+	layer_end_goal = 1 << 6
+};
+
+//The layer an object of the given type is on
+//Both kinds of enemy are "Enemy", so enemies pick their layer in their constructors instead
+inline int get_collision_layer_for_type(const string& type) {
+	if (type == "Player") return layer_player;
+	if (type == "Platform") return layer_platform;
+	if (type == "Pickup") return layer_pickup;
+	if (type == "Jump Pad") return layer_jump_pad;
+	if (type == "End Goal") return layer_end_goal;
+	return layer_none;
+}
+
+//The layers objects on a layer interact with
+inline int get_collision_mask_for_layer(int layer) {
+	switch (layer) {
+	case layer_player: return layer_ground_enemy | layer_flying_enemy | layer_platform | layer_pickup | layer_jump_pad | layer_end_goal;
+	//Ground enemies turn around at pickups. Flying enemies fly over them. Enemies don't touch each other, jump pads or end goals
+	case layer_ground_enemy: return layer_player | layer_platform | layer_pickup;
+	case layer_flying_enemy: return layer_player | layer_platform;
+	case layer_platform: return layer_player | layer_ground_enemy | layer_flying_enemy;
+	case layer_pickup: return layer_player | layer_ground_enemy;
+	case layer_jump_pad: return layer_player;
+	case layer_end_goal: return layer_player;
+	default: return layer_none;
+	}
+}
+
 class game_object {
 protected:
 	Vector2f inital_position; //The inital position of the object. Used to reset the objects position
 	string type; //The type of object ("Enemy", "Player", etc.)
 	RectangleShape shape; //The object's shape
-	Texture texture; //The object's texture
+	Texture* texture = nullptr; //The object's texture (shared, owned by the texture cache)
 	Sprite sprite; //The object's sprite
+	int render_flags = render_debug_outline; //Which visuals the renderer should draw for this object
+	int collision_layer = layer_none; //The layer this object is on (set from its type)
+	int collision_mask = layer_none; //The layers this object interacts with (set from its type)
+	bool active = true; //Whether the object is in play. Collected pickups and killed enemies are taken out until the level is reset
 public:
 	//Constructor
 	game_object(float x_position, float y_position, float width, float height, string type, Color color) {
@@ -26,18 +105,18 @@ public:
 		set_type(type);
 		set_color(color);
 		if (type == "Platform") {
-			texture.loadFromFile("platform.PNG");
-			texture.setRepeated(true);
-			sprite.setTexture(texture);
+			texture = &texture_cache::get_texture("platform.PNG");
+			sprite.setTexture(*texture);
 			sprite.setScale(3.125, 3.125);
 			sprite.setTextureRect(IntRect(0,0,width/ 3.125,height/ 3.125));
 			sprite.setPosition(x_position, y_position);
+			add_render_flags(render_sprite);
 		}
 	}
 	//Default constructor
 	game_object() = default;
 	//Destructor
-	~game_object(){};
+	virtual ~game_object(){};
 
 	//Called every frame (delta is the time between frame in seconds)
 	virtual void update(float delta) { update_sprite();  }
@@ -45,17 +124,58 @@ public:
 	//Called every time a collision is detected by the level manager
 	virtual int on_collision(string type_of_other_object, Vector2f other_position, Vector2f other_size) {return 0;}
 
+	//Whether objects of this type are solid to this object (used to stop fast movement tunnelling through them)
+	virtual bool blocks_movement(const string& type_of_other_object) { return false; }
+
+	//Adds the components for what this object is to its entity (see level_components.h). Called when its level becomes current
+	//Every object gets a level_object (and in_play while it's in play) from the level manager, so plain objects like platforms add nothing
+	virtual void add_components(ecs_world& world, entity self) {}
+
 	//Resets the position of the object
 	void reset_position() {
 		shape.setPosition(inital_position);
 	}
 
+	//Writes/reads everything about the object that changes during play (see level_snapshot.h)
+	//Objects with more state override both, calling the base versions first
+	virtual void save_state(state_writer& out) {
+		out.write(shape.getPosition());
+		out.write(active);
+	}
+	virtual void load_state(state_reader& in) {
+		Vector2f position;
+		if (in.read(position))
+			shape.setPosition(position);
+		in.read(active);
+		update_sprite();
+	}
+
 	//Applys gravity to an object. Should only be called if an object should have gravity applied to it
 	virtual void apply_gravity(float delta) {
 		float fall_speed = 50;
 		shape.move(0, 9.8 * fall_speed * delta);
 	}
 
+	//The animation this object should be playing (only used if its texture is a sprite sheet)
+	virtual animation_id get_animation() { return anim_idle; }
+	//Which variant of its animations (see animation.h)
+	virtual int get_animation_variant() { return 0; }
+
+	//Points the sprite at a shared texture and scales it to fill the object's shape
+	//Textures bigger than one frame are sprite sheets, so only the first frame is shown until the animation system takes over
+	void set_sprite_texture(const string& file_name) {
+		texture = &texture_cache::get_texture(file_name);
+		sprite.setTexture(*texture);
+		Vector2u frame_size = texture->getSize();
+		if (frame_size.x > (unsigned)sprite_frame_size || frame_size.y > (unsigned)sprite_frame_size) {
+			frame_size = Vector2u(sprite_frame_size, sprite_frame_size);
+			sprite.setTextureRect(IntRect(0, 0, sprite_frame_size, sprite_frame_size));
+		}
+		sprite.setScale(get_width() / frame_size.x, get_height() / frame_size.y);
+		sprite.setPosition(get_x_position(), get_y_position());
+		add_render_flags(render_sprite);
+	}
+
 	//Updates the sprite
 	virtual void update_sprite() {
 		//Update the sprites position to be the same as the shape's position
@@ -69,28 +189,77 @@ public:
 	float get_width() { return shape.getSize().x; };
 	float get_height() { return shape.getSize().y; };
 	string get_type() {return type;}
-	RectangleShape get_shape() { return shape; };
+	const RectangleShape& get_shape() { return shape; };
 	Color get_color() { return shape.getFillColor(); };
-	Sprite get_sprite() { return sprite; }
+	const Sprite& get_sprite() { return sprite; }
+	int get_render_flags() { return render_flags; }
+	Sprite& get_animated_sprite() { return sprite; }
+	bool has_render_flag(render_flag flag) { return (render_flags & flag) != 0; }
+	int get_collision_layer() { return collision_layer; }
+	int get_collision_mask() { return collision_mask; }
+	bool is_active() { return active; }
+	//Whether these two objects interact at all. Checked before any real collision work is done
+	bool can_collide_with(game_object* other) {
+		return (collision_mask & other->collision_layer) != 0 && (other->collision_mask & collision_layer) != 0;
+	}
 	//Setters
 	void set_inital_position(float x_position, float y_position) { inital_position.x = x_position; inital_position.y = y_position; };
 	void set_position(float x_position, float y_position) { shape.setPosition(Vector2f(x_position,y_position)); };
 	void set_size(float width, float height) { shape.setSize(Vector2f(width, height)); };
-	void set_type(string type) { this->type = type; };
-	void set_color(Color color) { shape.setFillColor(color); };
+	void set_type(string type) {
+		this->type = type;
+		set_collision_layer(get_collision_layer_for_type(type), get_collision_mask_for_layer(get_collision_layer_for_type(type)));
+	};
+	void set_collision_layer(int layer, int mask) { collision_layer = layer; collision_mask = mask; };
+	//Only the level manager should call this, so it can take the object in or out of its per-tick lists too
+	void set_active(bool active) { this->active = active; };
+	//Only ask for the shape to be drawn if it would actually be visible
+	void set_color(Color color) {
+		shape.setFillColor(color);
+		if (color.a > 0)
+			add_render_flags(render_shape);
+		else
+			remove_render_flags(render_shape);
+	};
+	void add_render_flags(int flags) { render_flags |= flags; };
+	void remove_render_flags(int flags) { render_flags &= ~flags; };
 	void set_sprite_position(Vector2f position) { sprite.setPosition(position); };
 };
 
+//Objects that are pushed out of solid objects by the contact solver (see contact_solver.h)
+//Instead of working out from overlaps which side of a platform they hit, they get told what they're touching
+class physics_body {
+protected:
+	contact_state contacts; //What the body was touching after the last solve
+
+public:
+	//Called after the solver has moved the body out of everything solid
+	virtual void on_contacts_solved(const contact_state& new_contacts) { contacts = new_contacts; }
+	//Called for each solid object the body is touching after the solve. normal points from the object towards the body
+	virtual void on_solid_contact(game_object* other, Vector2f normal) {}
+
+	//Snapshot helpers for the bodies' save_state/load_state
+	void save_contacts(state_writer& out) { out.write(contacts); }
+	void load_contacts(state_reader& in) { in.read(contacts); }
+
+	bool is_grounded() { return contacts.grounded; }
+	void set_grounded(bool grounded) { contacts.grounded = grounded; }
+	const contact_state& get_contacts() { return contacts; }
+
+	virtual ~physics_body() {};
+};
+
 class health_pickup : public game_object {
 protected:
 
 public:
 
 	health_pickup(float x_position, float y_position, float width, float height, string type, Color color) : game_object(x_position, y_position, width, height, type, color) {
-		texture.loadFromFile("health_pickup.PNG");
-		sprite.setTexture(texture);
-		sprite.setScale(width / texture.getSize().x, height / texture.getSize().y);
-		sprite.setPosition(x_position, y_position);
+		set_sprite_texture("health_pickup.PNG");
+	}
+
+	void add_components(ecs_world& world, entity self) override {
+		world.add(self, restores_health());
 	}
 
 	~health_pickup() {};
@@ -111,14 +280,15 @@ public:
 	}
 
 	speed_pickup(float x_position, float y_position, float width, float height, string type, Color color, int duration) : game_object(x_position, y_position, width, height, type, color) {
-		texture.loadFromFile("speed_pickup.PNG");
-		sprite.setTexture(texture);
-		sprite.setScale(width / texture.getSize().x, height / texture.getSize().y);
-		sprite.setPosition(x_position, y_position);
+		set_sprite_texture("speed_pickup.PNG");
 
 		set_duration(duration);
 	}
 
+	void add_components(ecs_world& world, entity self) override {
+		world.add(self, boosts_speed{ this });
+	}
+
 	~speed_pickup() {};
 };
 
@@ -142,23 +312,19 @@ public:
 	jump_pad(float x_position, float y_position, float width, float height, string type, Color color, int bounce) : game_object(x_position, y_position, width, height, type, color) {
 		set_bounce(bounce);
 
-		texture.loadFromFile("jump_pad.PNG");
-		texture.setRepeated(true);
-		sprite.setTexture(texture);
+		texture = &texture_cache::get_texture("jump_pad.PNG");
+		sprite.setTexture(*texture);
 		sprite.setScale(3.125, 3.125);
 		sprite.setTextureRect(IntRect(0, 0, width / 3.125, height / 3.125));
 		sprite.setPosition(x_position, y_position);
+		add_render_flags(render_sprite);
 	}
 	~jump_pad() {};
 };
 
 
-class player : public game_object {
+class player : public game_object, public physics_body {
 protected:
-	int floor_count = 0; //Keeps track of the number of floors the player is currently in contact with
-	int left_wall_count = 0;
-	int right_wall_count = 0;
-	int ceiling_count = 0;
 	enum move_speeds {
 		slowed = 150,
 		normal = 300,
@@ -166,7 +332,7 @@ protected:
 	};
 	float move_speed = static_cast<float>(move_speeds::normal); //Movement speed
 	
-	int power_up_duration;
+	int power_up_duration = 0;
 	
 
 	float jump_force = -1950; //Jump force
@@ -175,6 +341,8 @@ protected:
 
 	bool force_bounce = false;
 	bool on_down_pressed = false;
+	bool is_moving = false; //Whether the player moved left or right this tick (picks the run animation)
+	bool jumped = false; //Whether the player started a jump this tick
 
 	int health = 3;
 	void set_health(int health) {
@@ -187,14 +355,10 @@ protected:
 
 public:
 
-	map<int, Texture> health_textures;
-
 	//Constructor
 	player(float x_position, float y_position, float width, float height, string type, Color color) : game_object(x_position,y_position,width,height,type,color)  {
-		texture.loadFromFile("full_health_player.PNG");
-		sprite.setTexture(texture);
-		sprite.setScale(width / texture.getSize().x, height / texture.getSize().y);
-		sprite.setPosition(x_position, y_position);
+		//One sheet for every health value (see get_animation_variant)
+		set_sprite_texture("player_sheet.png");
 	}
 	//Destructor
 	~player() {};
@@ -211,70 +375,72 @@ public:
 		else
 			y_velocity = 0;
 
-		//Apply gravity only if the player isn't touching the ground
-		if (get_floor_count() < 1)
-			apply_gravity(delta);
-
+		//Gravity is applied afterwards by the level manager's gravity system (see has_gravity)
 		update_sprite();
 	}
 
+	void add_components(ecs_world& world, entity self) override {
+		world.add(self, player_controlled{ this });
+		world.add(self, reacts_to_contacts());
+		world.add(self, solved_body{ this });
+		world.add(self, has_gravity());
+	}
+
 	//Update player's movement
 	void update_movement(float delta, bool left, bool right, bool up, bool down) {
-		//Left pressed and not colliding with a wall
-		if (left && get_right_wall_count() < 1) {
+		is_moving = false;
+		jumped = false;
+		//Left pressed and not against a wall
+		if (left && !contacts.wall_left) {
 			//Move player
 			shape.move(-1 * get_move_speed() * delta, 0);
+			is_moving = true;
 		}
-		//Right pressed and not colliding with a wall
-		if (right && get_left_wall_count() < 1) {
+		//Right pressed and not against a wall
+		if (right && !contacts.wall_right) {
 			//Move player
 			shape.move(1 * get_move_speed() * delta, 0);
+			is_moving = true;
 		}
 		//Jump pressed and on a floor
-		if (get_floor_count() >= 1 && up) {
+		if (is_grounded() && up) {
 			//Set y velocity to the jump_force
 			y_velocity = jump_force;
+			jumped = true;
 		}
 		
 		set_on_down_pressed(down);
 		
 	}
 
-	//Override on collision function
-	int on_collision(string type_of_other_object, Vector2f other_position, Vector2f other_size) override{
-		//Check if other object is a platform
-		if (type_of_other_object == "Platform" || type_of_other_object == "Jump Pad") {
-			//Colliding with a wall on the left side of the platform
-			if (get_x_position() < other_position.x && get_y_position() > other_position.y - (get_height() - 10)) {
-				set_left_wall_count(get_left_wall_count() + 1);
-			}
-			//Colliding with a wall on the right side of the platform
-			else if (get_x_position() + get_width() > other_position.x + other_size.x && get_y_position() > other_position.y - (get_height() - 10)) {
-				set_right_wall_count(get_right_wall_count() + 1);
-			}
-			//Colliding with the floor of a platform
-			else if (get_y_position() + get_height() < other_position.y + 10) {
-				set_floor_count(get_floor_count() + 1);
-				set_force_bounce(false);
-				//reset jump force if the player is not on a jump pad
-				if (type_of_other_object == "Jump Pad") {
-					set_force_bounce(true);
-					return 2;
-				}
-				else {
-					
-					set_jump_force(get_default_jump_force());
-				}
-				
-			}
-			//Colliding with the ceiling of a platform
-			else if (get_y_position() > other_position.y) {
-				y_velocity = 0;
+	//Platforms and jump pads are handled by the contact solver
+	void on_contacts_solved(const contact_state& new_contacts) override {
+		contacts = new_contacts;
+		//Standing on something: back to a normal jump (a jump pad underneath turns the bounce back on below)
+		if (contacts.grounded) {
+			set_force_bounce(false);
+			set_jump_force(get_default_jump_force());
+		}
+		//Hit the ceiling: stop going up
+		if (contacts.on_ceiling && y_velocity < 0) {
+			y_velocity = 0;
+		}
+	}
+
+	//Standing on a jump pad forces a higher jump
+	void on_solid_contact(game_object* other, Vector2f normal) override {
+		if (normal.y < 0) {
+			if (jump_pad* pad = dynamic_cast<jump_pad*>(other)) {
+				set_force_bounce(true);
+				set_jump_force(get_default_jump_force() - pad->get_bounce());
 			}
-			return 1;
 		}
+	}
+
+	//Override on collision function
+	int on_collision(string type_of_other_object, Vector2f other_position, Vector2f other_size) override{
 		//i changed this function to an int because when it returns, if its 1 it will reset_level, but i cant call that from here
-		else if (type_of_other_object == "Enemy") {
+		if (type_of_other_object == "Enemy") {
 			//Colliding with a wall on the left side of the platform
 			if (get_x_position() < other_position.x && get_y_position() > other_position.y - (get_height() - 10)) {
 				
@@ -291,21 +457,19 @@ public:
 			}
 			else if (get_y_position() + get_height() < other_position.y + 10) {
 				
+				//Bounce off the enemy's head
 				set_jump_force(get_default_jump_force());
-				set_floor_count(get_floor_count() + 1);
+				set_grounded(true);
 				set_force_bounce(true);
 			}
 			return 1;
 		}
-		
+		return 1;
 	}
 
-	//Sets the collision counts to 0. Called at the beginning of the player's detect_collisions loop in the level manager
-	void reset_collision_counts() {
-		set_floor_count(0);
-		set_left_wall_count(0);
-		set_right_wall_count(0);
-		set_ceiling_count(0);
+	//The player stands on platforms and jump pads
+	bool blocks_movement(const string& type_of_other_object) override {
+		return type_of_other_object == "Platform" || type_of_other_object == "Jump Pad";
 	}
 
 	
@@ -314,20 +478,19 @@ public:
 	}
 	
 
-	void preload_player_sprites() {
-		Texture texture;
-		texture.loadFromFile("full_health_player.PNG");
-		health_textures[3] = texture;
-
-		texture.loadFromFile("mid_health_player.PNG");
-		health_textures[2] = texture;
-
-		texture.loadFromFile("low_health_player.PNG");
-		health_textures[1] = texture;
-	}
-
-	void update_player_sprite() {
-		sprite.setTexture(health_textures[get_health()]);
+	//Jumping/falling, running or standing still
+	animation_id get_animation() override {
+		if (y_velocity < 0 || !is_grounded())
+			return anim_jump;
+		if (is_moving)
+			return anim_run;
+		return anim_idle;
+	}
+	//Full health, two hearts, one heart
+	int get_animation_variant() override {
+		if (get_health() >= 3)
+			return 0;
+		return get_health() == 2 ? 1 : 2;
 	}
 	void update_powerups( ) {
 		if (get_powerup_duration() > 0) {
@@ -342,11 +505,44 @@ public:
 	}
 	void loose_heart() {
 		set_health(get_health() - 1);
-		update_player_sprite();
 	}
 	void add_health(int health) {
 		set_health(get_health() + health);
-		update_player_sprite();
+	}
+	void save_state(state_writer& out) override {
+		game_object::save_state(out);
+		save_contacts(out);
+		out.write(move_speed);
+		out.write(power_up_duration);
+		out.write(jump_force);
+		out.write(y_velocity);
+		out.write(force_bounce);
+		out.write(on_down_pressed);
+		out.write(is_moving);
+		out.write(jumped);
+		out.write(health);
+	}
+	void load_state(state_reader& in) override {
+		game_object::load_state(in);
+		load_contacts(in);
+		in.read(move_speed);
+		in.read(power_up_duration);
+		in.read(jump_force);
+		in.read(y_velocity);
+		in.read(force_bounce);
+		in.read(on_down_pressed);
+		in.read(is_moving);
+		in.read(jumped);
+		in.read(health);
+	}
+
+	//Puts back the health and speed boost from a save
+	void restore_saved_state(int health, int power_up_duration) {
+		set_health(health);
+		if (power_up_duration > 0) {
+			set_power_up_duration(power_up_duration);
+			boost_move_speed();
+		}
 	}
 	
 	//Getters
@@ -354,6 +550,9 @@ public:
 	bool get_on_down_pressed() {
 		return on_down_pressed;
 	}
+	bool get_jumped() {
+		return jumped;
+	}
 	bool get_force_bounce() {
 		return force_bounce;
 	}
@@ -367,27 +566,15 @@ public:
 	float get_jump_force() {
 		return jump_force;
 	}
-	int get_floor_count() {
-		return floor_count;
-	}
-	
-	int get_left_wall_count() {
-		return left_wall_count;
-	}
-	int get_right_wall_count() {
-		return right_wall_count;
-	}
-
-	int get_ceiling_count() {
-		return ceiling_count;
-	}
-
 	float get_move_speed() {
 		return move_speed;
 	}
 	int get_powerup_duration() {
 		return power_up_duration;
 	}
+	bool is_speed_boosted() {
+		return move_speed == static_cast<float>(move_speeds::boosted);
+	}
 	
 	//Setters
 	void set_on_down_pressed(bool on_down_pressed) {
@@ -402,18 +589,6 @@ public:
 			this->power_up_duration = power_up_duration;
 		}
 	}
-	void set_floor_count(int new_floor_count) {
-		floor_count = new_floor_count;
-	}
-	void set_left_wall_count(int new_num) {
-		left_wall_count = new_num;
-	}
-	void set_right_wall_count(int new_num) {
-		right_wall_count = new_num;
-	}
-	void set_ceiling_count(int new_num) {
-		ceiling_count = new_num;
-	}
 	void boost_move_speed() {
 		move_speed = static_cast<float>(move_speeds::boosted);
 	}
@@ -439,6 +614,7 @@ protected:
 	float initial_move_speed = 50;
 	bool invincible;
 	int travel_distance;
+	bool dead = false; //Set when the player kills the enemy
 
 	void set_initial_move_speed(float initial_move_speed) {
 		this->initial_move_speed = initial_move_speed;
@@ -480,6 +656,16 @@ public:
 	bool get_invincible() {
 		return invincible;
 	}
+	bool get_dead() {
+		return dead;
+	}
+	//Killed by the player. The level manager takes the enemy out of play until the level is reset
+	void kill() {
+		dead = true;
+	}
+	void revive() {
+		dead = false;
+	}
 	int get_travel_distance() {
 		return travel_distance;
 	}
@@ -512,6 +698,26 @@ public:
 		update_sprite();
 	}
 
+	void save_state(state_writer& out) override {
+		game_object::save_state(out);
+		out.write(left_wall_count);
+		out.write(right_wall_count);
+		out.write(move_speed);
+		out.write(dead);
+	}
+	void load_state(state_reader& in) override {
+		game_object::load_state(in);
+		in.read(left_wall_count);
+		in.read(right_wall_count);
+		in.read(move_speed);
+		in.read(dead);
+	}
+
+	//Enemies are always walking or flying
+	animation_id get_animation() override {
+		return anim_run;
+	}
+
 	//Enemy constructor
 	enemy(float x_position, float y_position, float width, float height, string type, Color color, float move_speed, int travel_distance, bool invincible) : game_object(x_position, y_position, width, height, type, color) {
 		set_move_speed(move_speed);
@@ -527,48 +733,23 @@ public:
 
 
 
-class ground_enemy: public  enemy {
+class ground_enemy: public  enemy, public physics_body {
 protected:
-	int floor_count = 0; //Keeps track of the number of floors the enemy is currently in contact with
-	
-	int ceiling_count = 0;
-
 	float y_velocity = 0; //Y velocity	
 
 public:
 
+	//Platforms and pickups are handled by the contact solver
 	int on_collision(string type_of_other_object, Vector2f other_position, Vector2f other_size) override {
-
-		//Check if other object is an platform
-		if (type_of_other_object == "Platform" || type_of_other_object == "Pickup" ) {
-			//Colliding with a wall on the left side of the platform
-			if (get_x_position() < other_position.x && get_y_position() > other_position.y - (get_height() - 10)) {
-				set_left_wall_count(get_left_wall_count() + 1);
-				change_direction();
-			}
-			//Colliding with a wall on the right side of the platform
-			else if (get_x_position() + get_width() > other_position.x + other_size.x && get_y_position() > other_position.y - (get_height() - 10)) {
-				set_right_wall_count(get_right_wall_count() + 1);
-				change_direction();
-			}
-			//Colliding with the floor of a platform
-			else if (get_y_position() + get_height() < other_position.y + 10) {
-				set_floor_count(get_floor_count() + 1);
-			}
-			else if (get_y_position() > other_position.y) {
-				y_velocity = 0;
-			}
-			return 0;
-		}
 		//i changed this function to an int because when it returns, if its 1 it will reset_level, but i cant call that from here
-		else if (type_of_other_object == "Player") {
+		if (type_of_other_object == "Player") {
 			//Colliding with a wall on the left side of the platform
 			if (get_y_position() > other_position.y) {
 				if (get_invincible()) {
 					return 1;
 				}
 				else {
-					shape.move(2000, 1000);
+					kill();
 					return 0;
 				}
 				
@@ -578,30 +759,36 @@ public:
 				return 1;
 				
 			}
-			
-			
-			return 0;
 		}
-
+		return 0;
 	}
-	void reset_collision_counts() {
-		set_floor_count(0);
-		set_left_wall_count(0);
-		set_right_wall_count(0);
+
+	//Turn around when walking into a wall, stop going up when hitting a ceiling
+	void on_contacts_solved(const contact_state& new_contacts) override {
+		contacts = new_contacts;
+		if ((contacts.wall_right && get_move_speed() > 0) || (contacts.wall_left && get_move_speed() < 0)) {
+			change_direction();
+		}
+		if (contacts.on_ceiling && y_velocity < 0) {
+			y_velocity = 0;
+		}
 	}
 
-	int get_floor_count() {
-		return floor_count;
+	void save_state(state_writer& out) override {
+		enemy::save_state(out);
+		save_contacts(out);
+		out.write(y_velocity);
 	}
-	void set_floor_count(int new_floor_count) {
-		floor_count = new_floor_count;
+	void load_state(state_reader& in) override {
+		enemy::load_state(in);
+		load_contacts(in);
+		in.read(y_velocity);
 	}
 
-	void set_ceiling_count(int new_num) {
-		ceiling_count = new_num;
+	//Ground enemies walk on platforms and turn around at pickups
+	bool blocks_movement(const string& type_of_other_object) override {
+		return type_of_other_object == "Platform" || type_of_other_object == "Pickup";
 	}
-	
-
 
 	void update(float delta) override {
 
@@ -614,27 +801,28 @@ public:
 		else
 			y_velocity = 0;
 
-		//Apply gravity only if the player isn't touching the ground
-		if (get_floor_count() < 1)
-			apply_gravity(delta);
-
+		//Gravity is applied afterwards by the level manager's gravity system (see has_gravity)
 		update_sprite();
 	}
 
+	void add_components(ecs_world& world, entity self) override {
+		world.add(self, patrols{ this });
+		world.add(self, reacts_to_contacts());
+		world.add(self, solved_body{ this });
+		world.add(self, has_gravity());
+	}
+
 	//Ground enemy constructor
 
 	ground_enemy(float x_position, float y_position, float width, float height, string type, Color color, int move_speed, int travel_distance, bool invincible) : enemy(x_position, y_position, width, height, type, color, move_speed, travel_distance, invincible), game_object(x_position, y_position, width, height, type, color) {
+		set_collision_layer(layer_ground_enemy, get_collision_mask_for_layer(layer_ground_enemy));
 		//Load texture image & apply to sprite
 		if (invincible) {
-			texture.loadFromFile("invincible_ground_enemy.PNG");
+			set_sprite_texture("invincible_ground_enemy.PNG");
 		}
 		else {
-			texture.loadFromFile("ground_enemy.PNG");
+			set_sprite_texture("ground_enemy.PNG");
 		}
-		
-		sprite.setTexture(texture);
-		sprite.setScale(width / texture.getSize().x, height / texture.getSize().y);
-		sprite.setPosition(x_position, y_position);
 	};
 	//Destructor
 	~ground_enemy() {};
@@ -646,17 +834,14 @@ public:
 
 	//Flying enemy constructor
 	flying_enemy(float x_position, float y_position, float width, float height, string type, Color color, int move_speed, int travel_distance, bool invincible) : enemy(x_position, y_position, width, height, type, color, move_speed, travel_distance, invincible), game_object(x_position, y_position, width, height, type, color) {
+		set_collision_layer(layer_flying_enemy, get_collision_mask_for_layer(layer_flying_enemy));
 		//Load texture image & apply to sprite
 		if (invincible) {
-			texture.loadFromFile("invincible_flying_enemy.PNG");
+			set_sprite_texture("invincible_flying_enemy.PNG");
 		}
 		else {
-			texture.loadFromFile("flying_enemy.PNG");
+			set_sprite_texture("flying_enemy.PNG");
 		}
-		
-		sprite.setTexture(texture);
-		sprite.setScale(width / texture.getSize().x, height / texture.getSize().y);
-		sprite.setPosition(x_position, y_position);
 	};
 
 	//Destructor
@@ -667,6 +852,16 @@ public:
 		update_sprite();
 	}
 
+	void add_components(ecs_world& world, entity self) override {
+		world.add(self, patrols{ this });
+		world.add(self, reacts_to_contacts());
+	}
+
+	//Flying enemies turn around at platforms
+	bool blocks_movement(const string& type_of_other_object) override {
+		return type_of_other_object == "Platform";
+	}
+
 	int on_collision(string type_of_other_object, Vector2f other_position, Vector2f other_size) override {
 		//i changed this function to an int because when it returns, if its 1 it will reset_level, but i cant call that from here
 		//Check if other object is an platform
@@ -693,7 +888,7 @@ public:
 			}
 			else {
 				if (get_y_position() > other_position.y) {
-					shape.move(2000, 1000);
+					kill();
 					return 0;
 				}
 				else {
@@ -715,10 +910,11 @@ protected:
 public:
 	end_goal(float x_position, float y_position, float width, float height, string type, Color color, int level) : game_object(x_position,y_position,width,height,type,color) {
 		set_level_to_load(level);
-		texture.loadFromFile("end_goal.PNG");
-		sprite.setTexture(texture);
-		sprite.setScale(width / texture.getSize().x, height / texture.getSize().y);
-		sprite.setPosition(x_position, y_position);
+		set_sprite_texture("end_goal.PNG");
+	}
+
+	void add_components(ecs_world& world, entity self) override {
+		world.add(self, level_exit{ this });
 	}
 
 	//Getter(s)
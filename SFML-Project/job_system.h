@@ -0,0 +1,303 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+using namespace std;
+
+class job_counter;
+
+//A piece of work and the counter to tick down once it's done
+//parallel_for() chunks don't need a function of their own: they call a shared body over their part of the range instead
+struct job {
+    function<void()> work;
+    job_counter* counter = nullptr;
+    void (*run_chunk)(const void* body, size_t first, size_t last) = nullptr; //Set for parallel_for() chunks, which leave work empty
+    const void* body = nullptr;
+    size_t first = 0;
+    size_t last = 0;
+};
+
+//Counts how many jobs in a group are still unfinished. Wait on it with job_system::wait()
+//Jobs started with run_after() are held here until the count reaches zero
+class job_counter {
+private:
+    friend class job_system;
+    atomic<int> remaining{ 0 };
+    mutex continuation_mutex;
+    vector<job> continuations;
+public:
+    //Constructor (default)
+    job_counter() = default;
+    job_counter(const job_counter&) = delete;
+    job_counter& operator=(const job_counter&) = delete;
+
+    //Getters
+    bool is_done() { return remaining == 0; }
+};
+
+//Work-stealing job scheduler shared by the engine (collision, particles, asset loading, ...)
+//Every worker has its own queue. Workers take their newest job first and steal the oldest job from someone else's queue when theirs is empty
+//Queue 0 belongs to the thread that created the system. Any thread waiting on a counter runs jobs while there are any,
+//and only sleeps once there's nothing left to run (until the counter is done or more jobs are queued)
+class job_system {
+private:
+    struct job_queue {
+        mutex queue_mutex;
+        deque<job> jobs;
+    };
+    vector<unique_ptr<job_queue>> queues;
+    vector<thread> threads;
+
+    mutex sleep_mutex;
+    condition_variable work_available; //Workers sleep on this
+    condition_variable counter_finished; //Threads in wait() sleep on this
+    //How many threads are asleep on each. Nobody is woken (and the lock isn't taken) when nobody is asleep.
+    //A thread counts itself before it checks whether to sleep, and a job or finished counter is published before the count is read, so no wake up is missed
+    atomic<int> sleeping_workers{ 0 };
+    atomic<int> sleeping_waiters{ 0 };
+    atomic<int> queued_jobs{ 0 };
+    atomic<bool> running{ true };
+
+    //The queue the current thread owns in this job system (-1 if it doesn't own one)
+    int get_queue_index() {
+        if (get_thread_owner() != this)
+            return -1;
+        return get_thread_queue();
+    }
+    static job_system*& get_thread_owner() {
+        static thread_local job_system* owner = nullptr;
+        return owner;
+    }
+    static int& get_thread_queue() {
+        static thread_local int queue = -1;
+        return queue;
+    }
+
+    job_queue& get_push_queue() {
+        int index = get_queue_index();
+        return *queues[index < 0 ? 0 : index];
+    }
+
+    void push(job new_job) {
+        job_queue& queue = get_push_queue();
+        {
+            lock_guard<mutex> lock(queue.queue_mutex);
+            queue.jobs.push_back(move(new_job));
+        }
+        queued_jobs++;
+        wake_for_jobs(false);
+    }
+
+    //Wakes sleeping threads up to run newly queued jobs
+    void wake_for_jobs(bool many) {
+        if (sleeping_workers == 0 && sleeping_waiters == 0)
+            return;
+        {
+            //Taking the lock makes sure a thread that is about to sleep sees the new jobs
+            lock_guard<mutex> lock(sleep_mutex);
+        }
+        if (many)
+            work_available.notify_all();
+        else
+            work_available.notify_one();
+        //Threads in wait() can help with them too
+        if (sleeping_waiters > 0)
+            counter_finished.notify_all();
+    }
+
+    //Takes a job from our own queue (newest first), or steals the oldest one from another queue
+    bool pop(int index, job& out) {
+        int queue_count = (int)queues.size();
+        if (index >= 0) {
+            job_queue& own = *queues[index];
+            lock_guard<mutex> lock(own.queue_mutex);
+            if (!own.jobs.empty()) {
+                out = move(own.jobs.back());
+                own.jobs.pop_back();
+                return true;
+            }
+        }
+        for (int offset = 1; offset <= queue_count; offset++) {
+            int victim = ((index < 0 ? 0 : index) + offset) % queue_count;
+            if (victim == index)
+                continue;
+            job_queue& queue = *queues[victim];
+            lock_guard<mutex> lock(queue.queue_mutex);
+            if (!queue.jobs.empty()) {
+                out = move(queue.jobs.front());
+                queue.jobs.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //Runs one queued job if there is one. Returns false if there was nothing to do
+    bool run_one(int index) {
+        job next;
+        if (!pop(index, next))
+            return false;
+        queued_jobs--;
+        if (next.run_chunk)
+            next.run_chunk(next.body, next.first, next.last);
+        else
+            next.work();
+        finish(next.counter);
+        return true;
+    }
+
+    //Ticks a counter down and starts anything that was waiting for it to finish
+    //The count only changes under the counter's lock, so a waiter can't destroy the counter while we're still using it
+    void finish(job_counter* counter) {
+        if (!counter)
+            return;
+        vector<job> ready;
+        bool done;
+        {
+            lock_guard<mutex> lock(counter->continuation_mutex);
+            done = --counter->remaining == 0;
+            if (done)
+                ready.swap(counter->continuations);
+        }
+        for (job& waiting : ready) {
+            push(move(waiting));
+        }
+        //The counter may be gone by now, so only the job system is touched from here on
+        if (done && sleeping_waiters > 0) {
+            {
+                lock_guard<mutex> lock(sleep_mutex);
+            }
+            counter_finished.notify_all();
+        }
+    }
+
+    template <typename F>
+    static void run_body(const void* body, size_t first, size_t last) {
+        (*static_cast<const F*>(body))(first, last);
+    }
+
+    //Worker thread loop. Runs jobs until there are none, then sleeps until more are pushed
+    void worker_loop(int index) {
+        get_thread_owner() = this;
+        get_thread_queue() = index;
+        while (running) {
+            if (run_one(index))
+                continue;
+            unique_lock<mutex> lock(sleep_mutex);
+            sleeping_workers++;
+            work_available.wait(lock, [this] { return queued_jobs > 0 || !running; });
+            sleeping_workers--;
+        }
+    }
+
+public:
+    //Constructor. By default uses one worker per core, minus the thread creating the system
+    job_system(int thread_count = -1) {
+        if (thread_count < 0)
+            thread_count = max(1, (int)thread::hardware_concurrency() - 1);
+        for (int i = 0; i <= thread_count; i++) {
+            queues.emplace_back(new job_queue());
+        }
+        get_thread_owner() = this;
+        get_thread_queue() = 0;
+        for (int i = 1; i <= thread_count; i++) {
+            threads.emplace_back(&job_system::worker_loop, this, i);
+        }
+    }
+    //Destructor. Jobs that haven't started yet are dropped, so wait on your counters first
+    ~job_system() {
+        running = false;
+        {
+            lock_guard<mutex> lock(sleep_mutex);
+        }
+        work_available.notify_all();
+        for (thread& worker : threads) {
+            worker.join();
+        }
+        if (get_thread_owner() == this)
+            get_thread_owner() = nullptr;
+    }
+    job_system(const job_system&) = delete;
+    job_system& operator=(const job_system&) = delete;
+
+    //Queues a job. counter goes up now and back down once the job has run
+    void run(function<void()> work, job_counter& counter) {
+        counter.remaining++;
+        push({ move(work), &counter });
+    }
+
+    //Queues a job that only starts once dependency is done
+    void run_after(job_counter& dependency, function<void()> work, job_counter& counter) {
+        counter.remaining++;
+        job waiting{ move(work), &counter };
+        {
+            lock_guard<mutex> lock(dependency.continuation_mutex);
+            if (dependency.remaining != 0) {
+                dependency.continuations.push_back(move(waiting));
+                return;
+            }
+        }
+        push(move(waiting));
+    }
+
+    //Runs jobs on this thread until every job counted by counter has finished
+    //Once there's nothing left to run (the last jobs are running on other threads) it sleeps instead of spinning
+    void wait(job_counter& counter) {
+        int index = get_queue_index();
+        while (counter.remaining != 0) {
+            if (run_one(index))
+                continue;
+            unique_lock<mutex> lock(sleep_mutex);
+            sleeping_waiters++;
+            counter_finished.wait(lock, [this, &counter] { return counter.remaining == 0 || queued_jobs > 0; });
+            sleeping_waiters--;
+        }
+        //Let the job that finished the counter let go of it before it can be destroyed
+        lock_guard<mutex> lock(counter.continuation_mutex);
+    }
+
+    //Calls body(first, last) for [0, count) split into chunks of chunk_size, spread over the workers, and waits for all of them
+    //Chunk k always covers [k * chunk_size, min(count, (k + 1) * chunk_size)), so results can be stored per chunk and merged in order
+    //Every chunk points at the same body, so splitting the work doesn't build a function per chunk, and the chunks are queued in one go
+    template <typename F>
+    void parallel_for(size_t count, size_t chunk_size, const F& body) {
+        if (count == 0)
+            return;
+        chunk_size = max(chunk_size, (size_t)1);
+        if (count <= chunk_size || threads.empty()) {
+            for (size_t first = 0; first < count; first += chunk_size) {
+                body(first, min(count, first + chunk_size));
+            }
+            return;
+        }
+
+        job_counter counter;
+        int chunks = (int)((count + chunk_size - 1) / chunk_size);
+        counter.remaining += chunks;
+        job_queue& queue = get_push_queue();
+        {
+            lock_guard<mutex> lock(queue.queue_mutex);
+            for (size_t first = 0; first < count; first += chunk_size) {
+                job chunk;
+                chunk.run_chunk = &run_body<F>;
+                chunk.body = &body;
+                chunk.first = first;
+                chunk.last = min(count, first + chunk_size);
+                chunk.counter = &counter;
+                queue.jobs.push_back(move(chunk));
+            }
+        }
+        queued_jobs += chunks;
+        wake_for_jobs(true);
+        wait(counter);
+    }
+
+    //Getters
+    int get_thread_count() { return (int)threads.size(); }
+};
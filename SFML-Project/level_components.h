@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+using namespace std;
+
+//Our files
+#include "ecs.h"
+
+class game_object;
+class physics_body;
+class player;
+class enemy;
+class speed_pickup;
+class end_goal;
+
+//Components for the objects in a level (see ecs.h)
+//Each object adds the components for what it is when its level starts (see game_object::add_components), and the level manager's systems
+//ask for what they need ("everything in play that patrols") instead of casting every object to find out what it is
+//The game_object classes still own the shapes, sprites and state that snapshots save, so components point at them rather than copy that state
+
+//The object in the level this entity stands for
+struct level_object {
+    size_t index; //Index in the level (level order)
+    game_object* object;
+};
+
+//Tags
+struct in_play {}; //Not collected or killed (see level_manager::set_in_play)
+struct reacts_to_contacts {}; //Has its collisions reacted to every tick (the player and enemies)
+struct has_gravity {}; //Falls unless it's standing on something (the gravity system). Only for solved bodies, which know if they're standing
+
+//Moved by the player's input
+struct player_controlled {
+    player* controlled;
+};
+
+//Walks or flies back and forth (the patrol system), and is killed or kills the player on contact
+struct patrols {
+    enemy* walker;
+};
+
+//Pushed out of solid objects by the contact solver, and told what it's touching afterwards
+struct solved_body {
+    physics_body* body;
+};
+
+//Pickups. Collecting one gives the player a heart and/or a speed boost for as long as the pickup says
+struct restores_health {};
+struct boosts_speed {
+    speed_pickup* pickup;
+};
+
+//Sends the player to the level the goal leads to when touched
+struct level_exit {
+    end_goal* goal;
+};
@@ -2,9 +2,23 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
 using namespace std;
 
 #include "game_objects.h"
+#include "render_thread.h"
+#include "animation.h"
+#include "sweep_and_prune.h"
+#include "aabb_tree.h"
+#include "swept_collision.h"
+#include "contact_solver.h"
+#include "job_system.h"
+#include "level_snapshot.h"
+#include "ecs.h"
+#include "level_components.h"
 
 //SFML files
 #include "SFML/Graphics.hpp"
@@ -13,204 +27,617 @@ using namespace std;
 //SFML namespace
 using namespace sf;
 
+//Things that happened in the level during a tick that the rest of the game may want to react to (effects, sounds)
+enum level_event_type {
+    event_enemy_killed,
+    event_pickup_collected,
+    event_player_jumped
+};
+struct level_event {
+    level_event_type type;
+    Vector2f position; //Where it happened
+};
+
+//How detect_collisions() finds the pairs of objects to check
+enum broadphase_type {
+    broadphase_brute_force, //Check every object against every other object
+    broadphase_sweep_and_prune //Only check pairs the sweep and prune says are overlapping
+};
+
 class level_manager {
 private:
     //Current level pointer
     vector<game_object*>* current_level = nullptr;
-    //screen size is 1400 by 800 (1400 wide, 800 tall). i recommend using desmos or geogebra to visualize how you want a level to look and then copy down the cords into the vector
-    //Level 1 vector
-    //IMPORTANT: Player should always be the first element in a level
+    //Built levels, by level id. Levels are built the first time they're needed (or prefetched in the background) and then kept
+    map<int, vector<game_object*>> built_levels;
+    int current_level_id = 0;
+    static const int level_count = 11; //Level 11 is the end screen
+    int pending_level_id = 0; //Level to switch to at the end of the tick (0 if none)
+    map<int, int> level_revisions; //How many times each level has been reloaded from its file (snapshots of older builds don't fit)
+
+    //How a level's objects were before it was first played, and which objects have changed since
+    //Resetting a level only puts back the changed objects, so levels full of platforms cost the same to reset as small ones
+    struct level_start {
+        vector<char> states; //Every object's save_state, one after the other
+        vector<size_t> state_offsets; //Where each object's state starts in states (plus one past the end)
+        vector<char> is_dirty; //Per object: whether it's in dirty_objects
+        vector<size_t> dirty_objects; //Objects that may have changed since the level started
+    };
+    map<int, level_start> level_starts;
+    level_start* current_start = nullptr;
+
+    //Records how the current level's objects are now, the first time it's played
+    void capture_level_start() {
+        level_start& start = level_starts[current_level_id];
+        current_start = &start;
+        if (start.state_offsets.size() == current_level->size() + 1)
+            return;
+
+        start = level_start();
+        state_writer out(start.states);
+        for (game_object* obj : *current_level) {
+            start.state_offsets.push_back(start.states.size());
+            obj->save_state(out);
+        }
+        start.state_offsets.push_back(start.states.size());
+        start.is_dirty.assign(current_level->size(), 0);
+    }
+
+    //Call whenever an object's state is changed after the level has started
+    void mark_dirty(size_t object) {
+        if (current_start && !current_start->is_dirty[object]) {
+            current_start->is_dirty[object] = 1;
+            current_start->dirty_objects.push_back(object);
+        }
+    }
+    void mark_all_dirty() {
+        for (size_t i = 0; i < current_level->size(); i++) {
+            mark_dirty(i);
+        }
+    }
+
+    //The next level being built on the job system
+    job_counter prefetching;
+    int prefetch_level_id = 0; //0 if nothing is being prefetched
+    vector<game_object*> prefetched_objects;
+
+    //Starts building the level the current level's end goal leads to in the background
+    void prefetch_next_level() {
+        if (prefetching.is_done())
+            finish_prefetch();
+        if (!jobs || !current_level || prefetch_level_id != 0)
+            return;
+
+        int next_level_id = 0;
+        entities.each<level_exit>([&](entity, level_exit& exit) {
+            if (next_level_id == 0)
+                next_level_id = exit.goal->get_level_to_load();
+        });
+        if (next_level_id < 1 || next_level_id > level_count || built_levels.count(next_level_id))
+            return;
+
+        prefetch_level_id = next_level_id;
+        jobs->run([this, next_level_id] { prefetched_objects = build_level(next_level_id); }, prefetching);
+    }
+
+    //Waits for the prefetch (if there is one) and keeps the level it built
+    void finish_prefetch() {
+        if (prefetch_level_id == 0)
+            return;
+        jobs->wait(prefetching);
+        built_levels[prefetch_level_id] = move(prefetched_objects);
+        prefetched_objects.clear();
+        prefetch_level_id = 0;
+    }
+
+    //A level's objects, building them now if they haven't been built or prefetched already
+    vector<game_object*>& get_built_level(int level_id) {
+        if (prefetch_level_id == level_id)
+            finish_prefetch();
+        auto found = built_levels.find(level_id);
+        if (found != built_levels.end())
+            return found->second;
+        return built_levels[level_id] = build_level(level_id);
+    }
+
+    //Builds a level's objects from its level file. Only reads the file and the texture cache, so it's safe to run on a worker thread
+    //screen size is 1400 by 800 (1400 wide, 800 tall). i recommend using desmos or geogebra to visualize how you want a level to look and then copy down the cords into the level file
+    //IMPORTANT: Player should always be the first object in a level
     //travel distance = (platform it is on length - 50)/2, has to be spawned on the middle 
-    vector<game_object*> level_1 = {
+    //Each line is one object: kind x y width height color, then any extra values that kind needs:
+    //  end_goal: level to load
+    //  ground_enemy, flying_enemy: move speed, travel distance, invincible (0 or 1)
+    //  speed_pickup: duration
+    //  jump_pad: bounce
+    //Kinds are player, platform, end_goal, ground_enemy, flying_enemy, speed_pickup, health_pickup and jump_pad. Colors are transparent, black or white
+    //Lines starting with # are comments
+    static vector<game_object*> build_level(int level_id) {
+        vector<game_object*> objects;
+        string file_name = get_level_file(level_id);
+        ifstream reader(file_name);
+        if (!reader.is_open()) {
+            cout << "Error loading level file: " << file_name << endl;
+            return objects;
+        }
 
-        new player(10, 650, 50, 50, "Player", Color::Transparent),
-        new end_goal(1300, 600, 50, 50, "End Goal", Color::Transparent, 2),
-        new game_object(0, 750, 250, 50, "Platform", Color::Black),
-        new game_object(400, 650, 450, 150, "Platform", Color::Black),
-        new game_object(1000, 650, 400, 150, "Platform", Color::Black),
-        new ground_enemy(600, 400, 50, 50, "Enemy", Color::Transparent, 50, 200, false),
+        string line;
+        int line_number = 0;
+        while (getline(reader, line)) {
+            line_number++;
+            stringstream values(line);
+            string kind, color_name;
+            float x, y, width, height;
+            if (!(values >> kind) || kind[0] == '#')
+                continue;
 
+            game_object* obj = nullptr;
+            if (values >> x >> y >> width >> height >> color_name) {
+                Color color = color_name == "black" ? Color::Black : color_name == "white" ? Color::White : Color::Transparent;
+                int first = 0, second = 0, third = 0;
+                if (kind == "player") {
+                    obj = new player(x, y, width, height, "Player", color);
+                }
+                else if (kind == "platform") {
+                    obj = new game_object(x, y, width, height, "Platform", color);
+                }
+                else if (kind == "end_goal" && values >> first) {
+                    obj = new end_goal(x, y, width, height, "End Goal", color, first);
+                }
+                else if (kind == "ground_enemy" && values >> first >> second >> third) {
+                    obj = new ground_enemy(x, y, width, height, "Enemy", color, first, second, third != 0);
+                }
+                else if (kind == "flying_enemy" && values >> first >> second >> third) {
+                    obj = new flying_enemy(x, y, width, height, "Enemy", color, first, second, third != 0);
+                }
+                else if (kind == "speed_pickup" && values >> first) {
+                    obj = new speed_pickup(x, y, width, height, "Pickup", color, first);
+                }
+                else if (kind == "health_pickup") {
+                    obj = new health_pickup(x, y, width, height, "Pickup", color);
+                }
+                else if (kind == "jump_pad" && values >> first) {
+                    obj = new jump_pad(x, y, width, height, "Jump Pad", color, first);
+                }
+            }
+            if (obj)
+                objects.push_back(obj);
+            else
+                cout << "Error in " << file_name << " line " << line_number << ": " << line << endl;
+        }
+        return objects;
+    }
 
-        
+    //Whether a level can be played: main and the collision code expect the player to be the first object
+    static bool has_player_first(const vector<game_object*>& objects) {
+        return !objects.empty() && dynamic_cast<player*>(objects[0]) != nullptr;
+    }
 
-       
-    };
-    //Level 2 vector
-    vector<game_object*> level_2 = {
-        new player(320, 50, 50, 50, "Player", Color::Transparent),
-        new game_object(320, 610, 400, 100, "Platform", Color::Black),
-        new game_object(500, 610, 400, 100, "Platform", Color::Black),
-        new ground_enemy(650, 400, 50, 50, "Enemy", Color::Transparent, 50, 200, false),
-        new game_object(900, 410, 300, 100, "Platform", Color::Black),
-         new end_goal(1100, 360, 50, 50, "End Goal", Color::Transparent, 3),
-    };
-    vector<game_object*> level_3 = {
-       new player(10, 650, 50, 50, "Player", Color::Transparent),
-        new game_object(0,750,250,50,"Platform",Color::Transparent),
-        new game_object(350,650,250,50,"Platform",Color::Transparent),
-        new ground_enemy(450, 600, 50, 50, "Enemy", Color::Transparent, 50, 100, false),
-        new game_object(650,250,100,700,"Platform",Color::Transparent),
-        new game_object(0,500,250,50,"Platform",Color::Transparent),
-        new game_object(350,350,150,50,"Platform",Color::Transparent),
-        new game_object(550,200,300,50,"Platform",Color::Transparent),
-        new flying_enemy(675,100,50,50,"Enemy",Color::Transparent,150,200, false),
-        new game_object(1000,500,300,50,"Platform",Color::Transparent),
-        new end_goal(1150,450,50,50,"End Goal", Color::Transparent, 5),
-    };
-    //Level 4 vector
-    vector<game_object*> level_4 = {
-          new player(220, 50, 50, 50, "Player", Color::Transparent),
-        new game_object(120, 110, 300, 100, "Platform", Color::Black),
-        //new game_object(500, 710, 400, 100, "Platform", Color::Black),
-
-        new game_object(700, -100, 100, 650, "Platform", Color::Black),
-        new game_object(750, 650, 100, 400, "Platform", Color::Black),
-         new game_object(850, 650, 300, 100, "Platform", Color::Black),
-        new game_object(420, 110, 100, 700, "Platform", Color::Black),
-         new flying_enemy(575, 250, 50, 50, "Enemy", Color::Transparent, 50, 250, false),
-         new flying_enemy(550, 150, 50, 50, "Enemy", Color::Transparent, 50, 250, false),
-         new flying_enemy(600, 350, 50, 50, "Enemy", Color::Transparent, 50, 250, false),
-         new flying_enemy(625, 450, 50, 50, "Enemy", Color::Transparent, 50, 250, false),
-       new flying_enemy(625, 650, 50, 50, "Enemy", Color::Transparent, 50, 250, false),
-       new flying_enemy(600, 750, 50, 50, "Enemy", Color::Transparent, 50, 250, false),
-       new flying_enemy(800, 500, 50, 50, "Enemy", Color::Transparent, 50, 150, false),
-       new end_goal(950, 280, 50, 50, "End Goal", Color::Transparent, 4),
-    };
-    //Level 5 vector
-    vector<game_object*> level_5 = {
-        new player(10, 650, 50, 50, "Player", Color::Transparent),
-        new game_object(0,750,250,50,"Platform",Color::Transparent),
-        new game_object(350,650,50,50,"Platform",Color::Transparent),
-        new game_object(550,650,50,50,"Platform",Color::Transparent),
-        new game_object(750,650,50,50,"Platform",Color::Transparent),
-        new game_object(950,650,50,50,"Platform",Color::Transparent),
-        new game_object(1150,650,50,50,"Platform",Color::Transparent),
-        new flying_enemy(750,550,50,50,"Enemy",Color::Transparent, 150, 200, false),
-        new end_goal(1150,600,50,50,"End Goal", Color::Transparent, 6),
-    };
-    vector<game_object*> level_6 = {
-          
+    //Frees a level's objects
+    static void delete_objects(vector<game_object*>& objects) {
+        for (game_object* obj : objects) {
+            delete obj;
+        }
+        objects.clear();
+    }
 
-         new player(10, 650, 50, 50, "Player", Color::Transparent),
-        new end_goal(1300, 600, 50, 50, "End Goal", Color::Transparent, 7),
+    //Broadphase
+    broadphase_type broadphase = broadphase_sweep_and_prune;
+    sweep_and_prune sweep;
+    vector<vector<size_t>> collision_candidates; //The objects each object is overlapping, kept sorted (sweep and prune)
+    vector<size_t> all_objects; //Every object index in the level (brute force). Objects out of play are skipped by generate_contacts()
 
-        //starting platform
-        new game_object(0, 750, 250, 50, "Platform", Color::Transparent),
-        //platform above the starting platform
-        new game_object(0, 550, 250, 50, "Platform", Color::Transparent),
-        
-        new game_object(400, 650, 150, 150, "Platform", Color::Transparent),
-        new flying_enemy(380, 400, 50, 50, "Enemy", Color::Transparent, -50, 400, false),
-        new game_object(500, 300, 50, 450, "Platform", Color::Transparent),
+    //Start the broadphase over for the current level
+    void rebuild_broadphase() {
+        all_objects.clear();
+        collision_candidates.assign(current_level->size(), vector<size_t>());
+        for (size_t i = 0; i < current_level->size(); i++) {
+            all_objects.push_back(i);
+        }
+        sweep.rebuild(*current_level);
+        apply_overlap_changes();
+    }
 
-        new flying_enemy(550, 300, 50, 50, "Enemy", Color::Transparent, 100, 200, false),
-        new flying_enemy(350, 200, 50, 50, "Enemy", Color::Transparent, 50, 200, false),
-        new flying_enemy(750, 350, 50, 50, "Enemy", Color::Transparent, 150, 200, false),
+    //Bring the broadphase up to date with where the objects are now
+    void update_broadphase() {
+        if (broadphase != broadphase_sweep_and_prune)
+            return;
+        sweep.update(*current_level);
+        apply_overlap_changes();
+    }
 
-        new game_object(1000, 650, 400, 150, "Platform", Color::Transparent),
-        new ground_enemy(450, 400, 50, 50, "Enemy", Color::Transparent, 50, 50, true),
-    };
-    //Level 7 vector
-    vector<game_object*> level_7 = {
-        new player(10, 650, 50, 50, "Player", Color::Transparent),
-        new end_goal(1300, 600, 50, 50, "End Goal", Color::Transparent, 8),
-        new game_object(0, 750, 250, 50, "Platform", Color::Transparent),
-        new game_object(400, 650, 450, 150, "Platform", Color::Transparent),
-        new game_object(1000, 650, 400, 150, "Platform", Color::Transparent),
-        new speed_pickup(600, 600, 50, 50, "Pickup", Color::Transparent, 1000),
-        new ground_enemy(600, 400, 50, 50, "Enemy", Color::Transparent, -50, 200, true),
-    };
-    vector<game_object*> level_8 = {
-        new player(10, 650, 50, 50, "Player", Color::Transparent),
-        new end_goal(1300, 600, 50, 50, "End Goal", Color::Transparent, 9),
-        new game_object(0, 750, 250, 50, "Platform", Color::Transparent),
-        new game_object(400, 650, 450, 150, "Platform", Color::Transparent),
-        new game_object(1000, 650, 400, 150, "Platform", Color::Transparent),
-        new ground_enemy(600, 400, 50, 50, "Enemy", Color::Transparent, 50, 200, false),
-    };
-    vector<game_object*> level_9 = {
-       new player(150, 50, 50, 50, "Player", Color::Transparent),
-        new game_object(100, 310, 200, 500, "Platform", Color::Black),
-        new game_object(600, 610, 400, 100, "Platform", Color::Black),
-         new game_object(375, 0, 100, 500, "Platform", Color::Black),
-         new flying_enemy(600, 730, 50, 50, "Enemy", Color::Transparent, -50, 250, false),
-
-         new flying_enemy(550, 200, 50, 50, "Enemy", Color::Transparent, 50, 250, false),
-         new flying_enemy(500, 400, 50, 50, "Enemy", Color::Transparent, 50, 250, false),
-         new flying_enemy(720, 500, 50, 50, "Enemy", Color::Transparent, 50, 250, false),
-         new flying_enemy(800, 300, 50, 50, "Enemy", Color::Transparent, -50, 250, false),
-         new end_goal(900, 60, 50, 50, "End Goal", Color::Transparent, 10),
-         new game_object(875, 100, 100, 100, "Platform", Color::Black),
-    };
-    vector<game_object*> level_10 = {
-        new player(25, 0, 50, 50, "Player", Color::Transparent),
-        new game_object(0, 150, 100, 100, "Platform", Color::Transparent),
-
-        new flying_enemy(325, 225, 50, 50, "Enemy", Color::Transparent, -300, 300, false),
-        new game_object(400, 0, 100, 300, "Platform", Color::Transparent),
-       new game_object(300, 300, 50, 50, "Platform", Color::Transparent),
-       new game_object(10, 500, 100, 50, "Platform", Color::Transparent),
-       new game_object(10, 500, 20, 250, "Platform", Color::Transparent),
-       new game_object(10, 750, 70, 50, "Platform", Color::Transparent),
-       new game_object(200, 580, 50, 50, "Platform", Color::Transparent),
-       new speed_pickup(25, 700, 50, 50, "Pickup", Color::Transparent, 2000),
-       new jump_pad(700, 750, 50, 50, "Jump Pad", Color::Transparent, 300),
-       new game_object(800, 550, 50, 400, "Platform", Color::Transparent),
-       new health_pickup(800, 500, 50, 50, "Pickup", Color::Transparent),
-       new jump_pad(1100, 700, 100, 100, "Jump Pad", Color::Transparent, 500),
-       new flying_enemy(1125, 500, 50, 50, "Enemy", Color::Transparent, -100, 225, false),
-       new flying_enemy(1125, 350, 50, 50, "Enemy", Color::Transparent, -200, 225, false),
-       new flying_enemy(1125, 200, 50, 50, "Enemy", Color::Transparent, -300, 225, false),
-       new end_goal(1100, 100, 50, 50, "End Goal", Color::Transparent, 11),
+    //Apply the pairs that started/stopped overlapping to the candidate lists
+    //Pairs whose collision layers don't interact never become candidates
+    void apply_overlap_changes() {
+        for (const overlap_pair& pair : sweep.get_begun_pairs()) {
+            if (!(*current_level)[pair.first]->can_collide_with((*current_level)[pair.second]))
+                continue;
+            add_candidate(pair.first, pair.second);
+            add_candidate(pair.second, pair.first);
+        }
+        for (const overlap_pair& pair : sweep.get_ended_pairs()) {
+            remove_candidate(pair.first, pair.second);
+            remove_candidate(pair.second, pair.first);
+        }
+    }
+    void add_candidate(size_t object, size_t other) {
+        vector<size_t>& candidates = collision_candidates[object];
+        auto position = lower_bound(candidates.begin(), candidates.end(), other);
+        if (position == candidates.end() || *position != other)
+            candidates.insert(position, other);
+    }
+    void remove_candidate(size_t object, size_t other) {
+        vector<size_t>& candidates = collision_candidates[object];
+        auto position = lower_bound(candidates.begin(), candidates.end(), other);
+        if (position != candidates.end() && *position == other)
+            candidates.erase(position);
+    }
 
+    //The objects that might be colliding with an object, in level order
+    const vector<size_t>& get_collision_candidates(size_t object) {
+        if (broadphase == broadphase_sweep_and_prune)
+            return collision_candidates[object];
+        return all_objects;
+    }
+
+    //Objects in play. Collected pickups and killed enemies aren't deleted or moved out of the way, they're taken out of play:
+    //out of the per-tick lists, the spatial index and the broadphase (which gives them empty bounds), and into a pool until the level is reset
+    //Neither list is kept in order: an object leaves its list by having the list's last entry swapped into its place, so moving
+    //one between them costs the same however big the level is. Anything that needs level order (the movers) sorts its own copy
+    vector<size_t> active_objects; //Everything that's updated each tick
+    vector<size_t> inactive_objects; //The pool of objects out of play
+    vector<size_t> list_positions; //Per object: where it is in whichever of the two lists it's in
+
+    //Entities for the current level's objects (see level_components.h). object_entities[i] is object i's entity
+    //Being in play is the in_play tag, so systems that only care about objects in play never see the others
+    ecs_world entities;
+    vector<entity> object_entities;
+
+    //Every object gets a level_object, plus whatever its class adds for what it is. None are in play until set_in_play() puts them there
+    void rebuild_entities() {
+        entities.clear();
+        object_entities.clear();
+        for (size_t i = 0; i < current_level->size(); i++) {
+            game_object* obj = (*current_level)[i];
+            object_entities.push_back(entities.create(level_object{ i, obj }));
+            obj->add_components(entities, object_entities.back());
+        }
+    }
+
+    void move_to_list(size_t object, vector<size_t>& from, vector<size_t>& to) {
+        size_t position = list_positions[object];
+        size_t last = from.back();
+        from[position] = last;
+        list_positions[last] = position;
+        from.pop_back();
+        list_positions[object] = to.size();
+        to.push_back(object);
+    }
+
+    //While detect_collisions() reacts to contacts it holds pointers into the entities' component columns, which moving an entity
+    //to another archetype (adding or removing in_play) would leave dangling. So the active flag changes straight away (it's what
+    //the reactions check) and the rest waits in in_play_changes until the reactions are done
+    bool is_reacting = false;
+    vector<size_t> in_play_changes;
+
+    //Puts an object in or out of play. This is the only place that does, so its active flag, its in_play tag, the two lists
+    //and the spatial index can't disagree. The broadphase gives objects out of play empty bounds, so it catches up on its next update
+    void set_in_play(size_t object, bool playing) {
+        game_object* obj = (*current_level)[object];
+        obj->set_active(playing);
+        if (is_reacting) {
+            in_play_changes.push_back(object);
+            return;
+        }
+        entity self = object_entities[object];
+        if (entities.has<in_play>(self) == playing)
+            return;
+
+        if (playing) {
+            move_to_list(object, inactive_objects, active_objects);
+            entities.add(self, in_play());
+            spatial_proxies[object] = spatial_index.insert((int)object, obj->get_shape().getGlobalBounds());
+        }
+        else {
+            move_to_list(object, active_objects, inactive_objects);
+            entities.remove<in_play>(self);
+            spatial_index.remove(spatial_proxies[object]);
+            spatial_proxies[object] = -1;
+        }
+    }
+
+    //Catches the in_play tags, lists and spatial index up with every active flag that changed while reacting to contacts
+    void apply_in_play_changes() {
+        is_reacting = false;
+        for (size_t object : in_play_changes) {
+            set_in_play(object, (*current_level)[object]->is_active());
+        }
+        in_play_changes.clear();
+    }
+
+    //Takes an object out of play until the level is reset
+    void deactivate_object(size_t object) {
+        if (!(*current_level)[object]->is_active())
+            return;
+        set_in_play(object, false);
+        mark_dirty(object);
+    }
+
+    //Puts every object in or out of play by its active flag, after states were loaded that may have changed them
+    void sync_active_objects() {
+        for (size_t i = 0; i < current_level->size(); i++) {
+            set_in_play(i, (*current_level)[i]->is_active());
+        }
+    }
+
+    //Contact generation. Finding which movers overlap what only reads the level, so big levels split it across the job system
+    //Each chunk of movers writes into its own buffer and the buffers are merged in chunk order, so the contacts always come out in level order
+    struct collision_contact {
+        size_t object;
+        size_t other;
     };
-    vector<game_object*> end_screen = {
-        new player(10, 650, 50, 50, "Player", Color::Transparent),
-        new game_object(0,750,1400,50,"Platform",Color::Transparent),
-        new game_object(300,200,150,50,"Platform",Color::Transparent),
-        new game_object(300,250,50,150,"Platform",Color::Transparent),
-        new game_object(350,300,50,50,"Platform",Color::Transparent),
-        new game_object(300,400,150,50,"Platform",Color::Transparent),
-        new game_object(500,200,50,250,"Platform",Color::Transparent),
-        new game_object(550,250,50,50,"Platform",Color::Transparent),
-        new game_object(600,300,50,50,"Platform",Color::Transparent),
-        new game_object(650,350,50,50,"Platform",Color::Transparent),
-        new game_object(700,200,50,250,"Platform",Color::Transparent),
-        new game_object(800,200,50,250,"Platform",Color::Transparent),
-        new game_object(850,200,50,50,"Platform",Color::Transparent),
-        new game_object(900,250,50,150,"Platform",Color::Transparent),
-        new game_object(850,400,50,50,"Platform",Color::Transparent),
-    };
+    job_system* jobs = nullptr; //Shared job system (owned by main). Everything runs on this thread if there isn't one
+    size_t parallel_collision_threshold = default_parallel_collision_threshold;
+    vector<size_t> movers; //Level indices of everything that reacts to collisions (player and enemies)
+    vector<vector<collision_contact>> contact_buffers; //One per chunk
+    vector<collision_contact> contacts; //Every contact this tick, in level order
+    vector<size_t> contacts_begin; //contacts[contacts_begin[i]] to contacts[contacts_end[i] - 1] are object i's contacts
+    vector<size_t> contacts_end;
+
+    //Finds everything object is overlapping that it needs to react to. Only reads the level, so it's safe to run on any thread
+    void generate_contacts(size_t object, vector<collision_contact>& out) {
+        game_object* obj = (*current_level)[object];
+        //Solid objects have already been handled by the contact solver
+        bool is_body = entities.has<solved_body>(object_entities[object]);
+        FloatRect bounds = obj->get_shape().getGlobalBounds();
+        for (size_t other : get_collision_candidates(object)) {
+            game_object* other_obj = (*current_level)[other];
+            if (other == object || !other_obj->is_active() || !obj->can_collide_with(other_obj))
+                continue;
+            if (is_body && obj->blocks_movement(other_obj->get_type()))
+                continue;
+            if (bounds.intersects(other_obj->get_shape().getGlobalBounds()))
+                out.push_back({ object, other });
+        }
+    }
+
+    //Generates this tick's contacts for every mover, in parallel when there are enough of them
+    void find_contacts() {
+        movers.clear();
+        entities.each<level_object>([this](entity, level_object& object) {
+            movers.push_back(object.index);
+        }, get_component_mask<reacts_to_contacts, in_play>());
+        sort(movers.begin(), movers.end());
+
+        //A few chunks per thread so stealing can even out uneven chunks. Forced parallel (a threshold of 0) splits even the smallest levels
+        size_t chunk_size = max(movers.size(), (size_t)1);
+        if (jobs && movers.size() >= parallel_collision_threshold) {
+            size_t min_chunk_size = parallel_collision_threshold == 0 ? 1 : 8;
+            chunk_size = max(min_chunk_size, movers.size() / ((size_t)jobs->get_thread_count() * 4 + 1));
+        }
+        size_t chunks = (movers.size() + chunk_size - 1) / chunk_size;
+        if (contact_buffers.size() < chunks)
+            contact_buffers.resize(chunks);
+
+        auto generate_chunk = [this, chunk_size](size_t first, size_t last) {
+            vector<collision_contact>& buffer = contact_buffers[first / chunk_size];
+            buffer.clear();
+            for (size_t k = first; k < last; k++) {
+                generate_contacts(movers[k], buffer);
+            }
+        };
+        if (jobs && chunks > 1)
+            jobs->parallel_for(movers.size(), chunk_size, generate_chunk);
+        else if (!movers.empty())
+            generate_chunk(0, movers.size());
+
+        //Merge the chunks back together in order
+        contacts.clear();
+        contacts_begin.assign(current_level->size(), 0);
+        contacts_end.assign(current_level->size(), 0);
+        for (size_t chunk = 0; chunk < chunks; chunk++) {
+            for (const collision_contact& contact : contact_buffers[chunk]) {
+                if (contacts_begin[contact.object] == contacts_end[contact.object])
+                    contacts_begin[contact.object] = contacts.size();
+                contacts.push_back(contact);
+                contacts_end[contact.object] = contacts.size();
+            }
+        }
+    }
+
+    //Spatial index of the objects in play (culling, line of sight, picking). spatial_proxies[i] is object i's proxy in the tree (-1 if it's out of play)
+    aabb_tree spatial_index;
+    vector<int> spatial_proxies;
+    vector<size_t> visible_objects; //Scratch list for build_draw_list()
+
+    //Objects that stay inside their fat box don't touch the tree
+    void update_spatial_index() {
+        for (size_t i : active_objects) {
+            spatial_index.move(spatial_proxies[i], (*current_level)[i]->get_shape().getGlobalBounds());
+        }
+    }
+
+    //How far an object is left inside a surface it was stopped at, so the usual overlap checks see the contact
+    const float contact_depth = 1;
+
+    //Continuous collision detection. The object moved from start_bounds to where it is now in one step.
+    //If that step carried it completely through something solid (so the overlap checks would never see it),
+    //move it back to where it first touched it and carry on sliding along the surface. Returns true if the object was moved
+    bool sweep_movement(game_object* obj, FloatRect start_bounds) {
+        Vector2f motion = obj->get_shape().getPosition() - Vector2f(start_bounds.left, start_bounds.top);
+        if (motion.x == 0 && motion.y == 0)
+            return false;
+
+        bool moved = false;
+        //A few passes so sliding along one surface can't skip through another
+        for (int pass = 0; pass < 3; pass++) {
+            FloatRect end_bounds(start_bounds.left + motion.x, start_bounds.top + motion.y, start_bounds.width, start_bounds.height);
+            float left = min(start_bounds.left, end_bounds.left);
+            float top = min(start_bounds.top, end_bounds.top);
+            FloatRect swept_area(left, top, start_bounds.width + fabs(motion.x), start_bounds.height + fabs(motion.y));
+
+            sweep_result earliest;
+            spatial_index.query(swept_area, [&](int other) {
+                game_object* other_obj = (*current_level)[other];
+                if (other_obj == obj || !obj->can_collide_with(other_obj) || !obj->blocks_movement(other_obj->get_type()))
+                    return true;
+                FloatRect other_bounds = other_obj->get_shape().getGlobalBounds();
+                //Ending up inside it is fine, the normal collision checks handle that. Only passing through it is a problem
+                if (end_bounds.intersects(other_bounds))
+                    return true;
+                sweep_result result = sweep_box(start_bounds, motion, other_bounds);
+                if (result.hit && result.time < earliest.time)
+                    earliest = result;
+                return true;
+            });
+
+            if (!earliest.hit) {
+                if (moved)
+                    obj->set_position(end_bounds.left, end_bounds.top);
+                return moved;
+            }
+
+            //Move up to the surface (and slightly into it), then keep only the movement along the surface
+            moved = true;
+            start_bounds.left += motion.x * earliest.time - earliest.normal.x * contact_depth;
+            start_bounds.top += motion.y * earliest.time - earliest.normal.y * contact_depth;
+            motion *= 1 - earliest.time;
+            if (earliest.normal.x != 0)
+                motion.x = 0;
+            else
+                motion.y = 0;
+        }
+
+        obj->set_position(start_bounds.left, start_bounds.top);
+        return moved;
+    }
+
+    //Contact solver and scratch lists so solving doesn't allocate every tick
+    contact_solver solver;
+    vector<solid_box> nearby_solids;
+    vector<solver_contact> solved_contacts;
+    vector<FloatRect> start_bounds; //Where each object was at the start of the tick
+
+    //Resolve a body's movement this tick (from start_bounds to where it is now) against the solid objects around it
+    void solve_contacts(game_object* obj, physics_body* body, FloatRect start_bounds) {
+        solver_body solver_input;
+        solver_input.start = start_bounds;
+        solver_input.motion = obj->get_shape().getPosition() - Vector2f(start_bounds.left, start_bounds.top);
+
+        //Everything solid the body could touch on its way, plus a little extra for the skin
+        float margin = solver.get_skin_width() + 1;
+        float left = min(start_bounds.left, start_bounds.left + solver_input.motion.x) - margin;
+        float top = min(start_bounds.top, start_bounds.top + solver_input.motion.y) - margin;
+        FloatRect area(left, top, start_bounds.width + fabs(solver_input.motion.x) + 2 * margin, start_bounds.height + fabs(solver_input.motion.y) + 2 * margin);
+
+        nearby_solids.clear();
+        spatial_index.query(area, [&](int other) {
+            game_object* other_obj = (*current_level)[other];
+            if (other_obj != obj && obj->can_collide_with(other_obj) && obj->blocks_movement(other_obj->get_type()))
+                nearby_solids.push_back({ other_obj->get_shape().getGlobalBounds(), other });
+            return true;
+        });
+        //Solve in level order so the result doesn't depend on the tree's layout
+        sort(nearby_solids.begin(), nearby_solids.end(), [](const solid_box& a, const solid_box& b) { return a.id < b.id; });
+
+        solver.solve(solver_input, nearby_solids, solved_contacts);
+        obj->set_position(solver_input.bounds.left, solver_input.bounds.top);
+        body->on_contacts_solved(solver_input.state);
+        for (const solver_contact& contact : solved_contacts) {
+            body->on_solid_contact((*current_level)[contact.id], contact.normal);
+        }
+    }
+
+    //Events from the current tick. Cleared by whoever handles them
+    vector<level_event> events;
 
+    //Animated sprites in the current level. animated_objects[i] owns the sprite behind animation handle i
+    animation_system animations;
+    vector<game_object*> animated_objects;
+
+    //Point every animated object at the animation (and variant) its state calls for
+    void play_animations() {
+        for (size_t i = 0; i < animated_objects.size(); i++) {
+            animations.play((int)i, animated_objects[i]->get_animation(), animated_objects[i]->get_animation_variant());
+        }
+    }
+
+    //Register every object in the current level whose texture is a sprite sheet with the animation system
+    void register_animations() {
+        animations.clear();
+        animated_objects.clear();
+        for (auto obj : *current_level) {
+            if (animations.add(obj->get_animated_sprite()) >= 0) {
+                animated_objects.push_back(obj);
+            }
+        }
+    }
 
 public:
     //Constructor (default)
     level_manager() = default;
+    //Destructor. A level still being prefetched writes into the level manager, so it has to finish first
+    ~level_manager() { finish_prefetch(); }
 
     //Run update function for all objects in the current level
+    //Each object still goes input or patrol, update, gravity, then sweep and solve, but each step runs as a system over everything it applies to
     void update_all_objects(Time delta, bool left_input, bool right_input, bool up_input, bool down_input) {
         if (!current_level) return; // No level set
 
-        for (auto obj : *current_level) {
-            if (player* plyr = dynamic_cast<player*>(obj) ) {
-                // Update player movement
-                plyr->update_movement(delta.asMicroseconds() / 1'000'000.0f, left_input, right_input, up_input, down_input);
-                
-                
-            }
-            else if (ground_enemy* enmy = dynamic_cast<ground_enemy*>(obj)) {
-                enmy->update_movement(delta.asMicroseconds() / 1'000'000.0f);
-                
+        float seconds = delta.asMicroseconds() / 1'000'000.0f;
+        component_mask playing = get_component_mask<in_play>();
+
+        //Where each object was before it moved this tick
+        start_bounds.resize(current_level->size());
+        for (size_t i : active_objects) {
+            start_bounds[i] = (*current_level)[i]->get_shape().getGlobalBounds();
+        }
+
+        //Input system
+        entities.each<level_object, player_controlled>([&](entity, level_object& object, player_controlled& control) {
+            player* plyr = control.controlled;
+            mark_dirty(object.index);
+            plyr->update_movement(seconds, left_input, right_input, up_input, down_input);
+            if (plyr->get_jumped()) {
+                //Jump from the player's feet
+                events.push_back({ event_player_jumped, Vector2f(plyr->get_x_position() + plyr->get_width() / 2, plyr->get_y_position() + plyr->get_height()) });
             }
-            else if (flying_enemy* fly_enmy = dynamic_cast<flying_enemy*>(obj)) {
-                fly_enmy->update_movement(delta.asMicroseconds() / 1'000'000.0f);
+        }, playing);
+
+        //Patrol system
+        entities.each<level_object, patrols>([&](entity, level_object& object, patrols& patrol) {
+            mark_dirty(object.index);
+            patrol.walker->update_movement(seconds);
+        }, playing);
+
+        for (size_t i : active_objects) {
+            (*current_level)[i]->update(seconds);
+        }
+
+        //Gravity system
+        entities.each<level_object, solved_body>([&](entity, level_object& object, solved_body& body) {
+            if (!body.body->is_grounded())
+                object.object->apply_gravity(seconds);
+        }, get_component_mask<has_gravity, in_play>());
+
+        for (size_t i : active_objects) {
+            game_object* obj = (*current_level)[i];
+
+            //Make sure the object didn't skip through anything solid this tick
+            bool was_swept = sweep_movement(obj, start_bounds[i]);
 
+            //Push bodies back out of anything solid and tell them what they're touching
+            if (solved_body* body = entities.get<solved_body>(object_entities[i])) {
+                solve_contacts(obj, body->body, start_bounds[i]);
+                obj->update_sprite();
+            }
+            else if (was_swept) {
+                obj->update_sprite();
             }
-            
-            obj->update(delta.asMicroseconds() / 1'000'000.0f);
-            
-            
         }
+
+        //Pick each animated object's animation, then advance them all in one pass
+        play_animations();
+        animations.update(seconds);
         
     }
 
@@ -218,51 +645,50 @@ public:
     void detect_collisions(Time delta) {
         if (!current_level) return; // No level set
 
-        for (size_t i = 0; i < current_level->size(); i++) {
-            //Check if our current selection is the player
-            if (player* plyr = dynamic_cast<player*>((*current_level)[i])) {
-                // Reset floor count
-                plyr->reset_collision_counts();
-                
+        update_broadphase();
+        find_contacts();
 
-                // Check collisions with every other object
-                for (size_t j = 0; j < current_level->size(); j++) {
-                    
-                    //Make sure we aren't currently trying to check the player with itself
-                    if (i != j) {
-                        //Check if the object's shape is intersecting the player's shape
-                        if (plyr->get_shape().getGlobalBounds().intersects((*current_level)[j]->get_shape().getGlobalBounds())) {
-                            //Call the on_collision function
-                            
-                            if (plyr->on_collision((*current_level)[j]->get_type(), (*current_level)[j]->get_shape().getPosition(), (*current_level)[j]->get_shape().getSize()) == 0) {
-                                //sounds[2].play();
-                                reset_level();
-                            }
-                            else if (plyr->on_collision((*current_level)[j]->get_type(), (*current_level)[j]->get_shape().getPosition(), (*current_level)[j]->get_shape().getSize()) == 2) {
-                                if (jump_pad* jmp_pd = dynamic_cast<jump_pad*>((*current_level)[j])) {
-
-                                    plyr->set_jump_force(plyr->get_default_jump_force() - jmp_pd->get_bounce());
-                                   
-                                }
-                            }
-                            if (health_pickup* hlth_pickup = dynamic_cast<health_pickup*>((*current_level)[j])) {
-                                plyr->add_health(1);
-                                hlth_pickup->set_position(2000, 2000);
-                            }
-                            else if (speed_pickup* spd_pickup = dynamic_cast<speed_pickup*>((*current_level)[j])) {
-                                plyr->boost_move_speed();
-                                spd_pickup->set_position(2000, 2000);
-                                int duration = spd_pickup->get_duration();
-                                
-                                plyr->set_power_up_duration(duration);
-                                
-                            }
-                            //Check if object is the end goal
-                            if (end_goal* goal = dynamic_cast<end_goal*>((*current_level)[j])) {
-                                set_current_level(goal->get_level_to_load());
-                            }
-                            
+        //Contacts are reacted to one at a time on this thread, in level order
+        //Reacting to one can move things (resets, kills, pickups), so each is checked again before it's used
+        is_reacting = true;
+        for (size_t i : movers) {
+            //Killed earlier this tick
+            if (!(*current_level)[i]->is_active())
+                continue;
+            //Check if our current selection is the player
+            if (player_controlled* control = entities.get<player_controlled>(object_entities[i])) {
+                player* plyr = control->controlled;
+                // Check collisions with every object the player was touching
+                for (size_t c = contacts_begin[i]; c < contacts_end[i]; c++) {
+                    size_t j = contacts[c].other;
+                    //Check if the object's shape is still intersecting the player's shape
+                    if ((*current_level)[j]->is_active() && plyr->get_shape().getGlobalBounds().intersects((*current_level)[j]->get_shape().getGlobalBounds())) {
+                        //Call the on_collision function
+                        
+                        if (plyr->on_collision((*current_level)[j]->get_type(), (*current_level)[j]->get_shape().getPosition(), (*current_level)[j]->get_shape().getSize()) == 0) {
+                            //sounds[2].play();
+                            reset_level();
+                        }
+                        entity other = object_entities[j];
+                        if (entities.has<restores_health>(other)) {
+                            events.push_back({ event_pickup_collected, get_center((*current_level)[j]) });
+                            plyr->add_health(1);
+                            deactivate_object(j);
                         }
+                        else if (boosts_speed* boost = entities.get<boosts_speed>(other)) {
+                            events.push_back({ event_pickup_collected, get_center((*current_level)[j]) });
+                            plyr->boost_move_speed();
+                            plyr->set_power_up_duration(boost->pickup->get_duration());
+                            deactivate_object(j);
+                        }
+                        //Check if object is the end goal
+                        if (level_exit* exit = entities.get<level_exit>(other)) {
+                            //Switch once the tick is over (see apply_level_switch). The rest of the old level's collisions don't matter anymore
+                            pending_level_id = exit->goal->get_level_to_load();
+                            apply_in_play_changes();
+                            return;
+                        }
+                        
                     }
                 }
 
@@ -272,24 +698,29 @@ public:
                     reset_level();
                 }
             }
-            else if (ground_enemy * enmy = dynamic_cast<ground_enemy*>((*current_level)[i])) {
-                enmy->reset_collision_counts();
-
-                for (size_t j = 0; j < current_level->size(); j++) {
-                    //Make sure we aren't currently trying to check the enemy with itself
-                    if (i != j) {
-                        //Check if the object's shape is intersecting the enemies shape
-                        if (enmy->get_shape().getGlobalBounds().intersects((*current_level)[j]->get_shape().getGlobalBounds())) {
-                            //Call the on_collision function
-
-
-                            if (enmy->on_collision((*current_level)[j]->get_type(), (*current_level)[j]->get_shape().getPosition(), (*current_level)[j]->get_shape().getSize())) {
-                                reset_level();
-                            }
-                            
-                            
-                            
+            //Enemies (walking or flying)
+            else if (patrols* patrol = entities.get<patrols>(object_entities[i])) {
+                enemy* enmy = patrol->walker;
+                for (size_t c = contacts_begin[i]; c < contacts_end[i]; c++) {
+                    size_t j = contacts[c].other;
+                    //Check if the object's shape is still intersecting the enemies shape
+                    if ((*current_level)[j]->is_active() && enmy->get_shape().getGlobalBounds().intersects((*current_level)[j]->get_shape().getGlobalBounds())) {
+                        //Call the on_collision function
+
+
+                        Vector2f enemy_center = get_center(enmy);
+                        bool was_dead = enmy->get_dead();
+                        if (enmy->on_collision((*current_level)[j]->get_type(), (*current_level)[j]->get_shape().getPosition(), (*current_level)[j]->get_shape().getSize())) {
+                            reset_level();
                         }
+                        else if (!was_dead && enmy->get_dead()) {
+                            events.push_back({ event_enemy_killed, enemy_center });
+                            deactivate_object(i);
+                            break;
+                        }
+                        
+                        
+                        
                     }
                 }
                 /*
@@ -304,76 +735,191 @@ public:
                 }
                 */
             }
-            else if (flying_enemy* fly_enmy = dynamic_cast<flying_enemy*>((*current_level)[i])) {
-                
-
-                for (size_t j = 0; j < current_level->size(); j++) {
-                    //Make sure we aren't currently trying to check the enemy with itself
-                    if (i != j) {
-                        //Check if the object's shape is intersecting the enemies shape
-                        if (fly_enmy->get_shape().getGlobalBounds().intersects((*current_level)[j]->get_shape().getGlobalBounds())) {
-                            //Call the on_collision function
 
+        }
+        apply_in_play_changes();
 
-                            if (fly_enmy->on_collision((*current_level)[j]->get_type(), (*current_level)[j]->get_shape().getPosition(), (*current_level)[j]->get_shape().getSize())) {
-                                reset_level();
-                            }
+        //Everything has finished moving for this tick
+        update_spatial_index();
+    }
 
-  
+    //Fill a draw list with the objects in the current level that are inside the visible area
+    //Only the visuals an object has asked for are added
+    void build_draw_list(draw_list& list, bool draw_debug_overlay, const FloatRect& visible_area) {
+        list.clear();
+        if (!current_level) return; // No level set
 
-                        }
-                    }
-                }
-                /*
-                * //i had to comment this out because when the player would kill an enemy, then die the killed enemies would not respawn becase they were removed
-                //Check if the enemy is out of bounds and remove them from the vector
-                if (fly_enmy->get_y_position() > 1000) {
-                    //remove the j-ith index of the vector
-                    current_level->erase(current_level->begin() + i);
+        //Cull everything off screen, then put the rest back in level order so they draw in the same order as always
+        visible_objects.clear();
+        spatial_index.query(visible_area, [this](int object) {
+            visible_objects.push_back(object);
+            return true;
+        });
+        sort(visible_objects.begin(), visible_objects.end());
 
-                    // 
-                    i--;
-                }
-                */
+        for (size_t i : visible_objects) {
+            game_object* obj = (*current_level)[i];
+            if (obj->has_render_flag(render_shape)) {
+                //Filled shapes are batched into a single vertex array of quads
+                FloatRect bounds = obj->get_shape().getGlobalBounds();
+                Color color = obj->get_color();
+                list.shapes.append(Vertex(Vector2f(bounds.left, bounds.top), color));
+                list.shapes.append(Vertex(Vector2f(bounds.left + bounds.width, bounds.top), color));
+                list.shapes.append(Vertex(Vector2f(bounds.left + bounds.width, bounds.top + bounds.height), color));
+                list.shapes.append(Vertex(Vector2f(bounds.left, bounds.top + bounds.height), color));
             }
+            if (obj->has_render_flag(render_sprite))
+                list.sprites.push_back(obj->get_sprite());
+        }
 
+        if (draw_debug_overlay)
+            build_debug_overlay(list.debug_overlay);
+    }
+
+    //Fill the debug overlay with an outline (4 lines) around the bounds of every visible object that wants one
+    void build_debug_overlay(VertexArray& overlay) {
+        for (size_t i : visible_objects) {
+            game_object* obj = (*current_level)[i];
+            if (!obj->has_render_flag(render_debug_outline))
+                continue;
+
+            FloatRect bounds = obj->get_shape().getGlobalBounds();
+            Vector2f corners[4] = {
+                Vector2f(bounds.left, bounds.top),
+                Vector2f(bounds.left + bounds.width, bounds.top),
+                Vector2f(bounds.left + bounds.width, bounds.top + bounds.height),
+                Vector2f(bounds.left, bounds.top + bounds.height)
+            };
+            for (int corner = 0; corner < 4; corner++) {
+                overlay.append(Vertex(corners[corner], Color::Red));
+                overlay.append(Vertex(corners[(corner + 1) % 4], Color::Red));
+            }
         }
     }
 
-    //Reset the positions of all objects in the level
+    //The object drawn on top at a point (nullptr if there isn't one). Used for mouse picking
+    game_object* pick_object(Vector2f point) {
+        if (!current_level) return nullptr;
+
+        int top_object = -1;
+        spatial_index.query(FloatRect(point.x, point.y, 0.001f, 0.001f), [&top_object](int object) {
+            top_object = max(top_object, object);
+            return true;
+        });
+        return top_object >= 0 ? (*current_level)[top_object] : nullptr;
+    }
+
+    //Whether a straight line from the player to an object is clear of platforms (other than the object itself)
+    bool has_line_of_sight(game_object* target) {
+        if (!current_level || current_level->empty()) return false;
+
+        raycast_hit hit = spatial_index.raycast(get_center((*current_level)[0]), get_center(target), [this, target](int object) {
+            game_object* obj = (*current_level)[object];
+            return obj != target && obj->get_type() == "Platform";
+        });
+        return !hit.hit;
+    }
+
+    //Puts the level back how it started. Only objects that changed since are touched
+    //The player goes back to the start too, but keeps its power ups (apart from the speed boost) and loses a heart
+    //Everything taken out of play is dirty, so the pool is emptied back into play by the same walk
     void reset_level() {
-        for (size_t i = 0; i < current_level->size(); i++) {
-            (*current_level)[i]->reset_position();
-            //resets the direction an enemy is traveling 
-            if (enemy* enmy = dynamic_cast<enemy*>((*current_level)[i]) ) {
-                 enmy->reset_move_speed();
-            }
-            else if (player* plyr = dynamic_cast<player*>((*current_level)[i])) {
-                plyr->loose_heart();
-                plyr->normal_move_speed();
-            }
+        if (!current_start) return;
+
+        for (size_t i : current_start->dirty_objects) {
+            game_object* obj = (*current_level)[i];
+            current_start->is_dirty[i] = 0;
+            if (entities.has<player_controlled>(object_entities[i]))
+                continue;
+            size_t offset = current_start->state_offsets[i];
+            state_reader in(current_start->states.data() + offset, current_start->state_offsets[i + 1] - offset);
+            obj->load_state(in);
+            set_in_play(i, obj->is_active());
+        }
+        current_start->dirty_objects.clear();
+
+        //Every reset costs a heart, even a second one in the same tick when the player hasn't been marked dirty again
+        //(levels always start with the player, see has_player_first)
+        if (player_controlled* control = entities.get<player_controlled>(object_entities[0])) {
+            player* plyr = control->controlled;
+            plyr->reset_position();
+            plyr->loose_heart();
+            plyr->normal_move_speed();
+        }
+    }
+
+    //Captures the state of everything in the current level
+    level_snapshot capture_snapshot() {
+        level_snapshot snapshot;
+        capture_snapshot(snapshot);
+        return snapshot;
+    }
+    //Captures into an existing snapshot, reusing its memory (for capturing every tick)
+    void capture_snapshot(level_snapshot& snapshot) {
+        snapshot.level_id = 0;
+        snapshot.data.clear();
+        if (!current_level) return;
+
+        snapshot.level_id = current_level_id;
+        snapshot.level_revision = level_revisions[current_level_id];
+        snapshot.object_count = current_level->size();
+        state_writer out(snapshot.data);
+        for (game_object* obj : *current_level) {
+            obj->save_state(out);
+        }
+    }
+
+    //Puts a level back how it was when the snapshot was captured, switching to its level first if needed
+    //Returns false if the snapshot doesn't fit the level anymore (it was reloaded from its file since)
+    bool restore_snapshot(const level_snapshot& snapshot) {
+        if (snapshot.is_empty() || snapshot.level_revision != level_revisions[snapshot.level_id])
+            return false;
+        if (snapshot.level_id != current_level_id && !set_current_level(snapshot.level_id))
+            return false;
+        if (!current_level || current_level->size() != snapshot.object_count)
+            return false;
+
+        state_reader in(snapshot.data);
+        for (game_object* obj : *current_level) {
+            obj->load_state(in);
         }
+        mark_all_dirty();
+        if (!in.is_complete())
+            cout << "Snapshot of level " << snapshot.level_id << " didn't match the level" << endl;
+        pending_level_id = 0;
+
+        //Sprites show the restored state straight away
+        play_animations();
+
+        //Bring the broadphase up to date with wherever everything is now, and with what came in or out of play. Only what moved is
+        //sorted again, which matters when rewinding restores a snapshot every tick (switching level above has already rebuilt it)
+        update_broadphase();
+        sync_active_objects();
+        update_spatial_index();
+        return true;
     }
 
     //Delete all of the levels. Called when the game is ended
     void delete_levels() {
-        level_1.clear();
-        level_2.clear();
-        level_3.clear();
-        level_4.clear();
-        level_5.clear();
-        level_6.clear();
-        level_7.clear();
-        level_8.clear();
-        level_9.clear();
-        level_10.clear();
-        end_screen.clear();
+        finish_prefetch();
+        for (auto& level : built_levels) {
+            delete_objects(level.second);
+        }
+        built_levels.clear();
+        current_level = nullptr;
+        entities.clear();
+        object_entities.clear();
+    }
+
+    //Center point of an object's shape
+    Vector2f get_center(game_object* obj) {
+        return Vector2f(obj->get_x_position() + obj->get_width() / 2, obj->get_y_position() + obj->get_height() / 2);
     }
 
     //Getters & Setters
     //Getters
-    int get_current_level_size() {
-        return (int)level_1.size();
+    vector<level_event>& get_events() {
+        return events;
     }
     int get_current_level_size() const {
         return current_level ? (int)current_level->size() : 0;
@@ -382,79 +928,141 @@ public:
         return current_level;
     }
     int get_current_level_id() {
-        if (current_level == &level_1) {
+        //The end screen saves as level 1
+        if (current_level_id < 1 || current_level_id >= level_count)
             return 1;
+        return current_level_id;
+    }
+    //How many level files there are (the end screen is the last one)
+    static int get_level_count() { return level_count; }
+    //Setters
+    //Returns false if the level couldn't be played (its file is missing or doesn't start with the player). The current level carries on
+    //in that case, or level 1 is played if there isn't one yet
+    bool set_current_level(int level_id) {
+        if ((level_id < 1 || level_id > level_count) && !built_levels.count(level_id)) {
+            cout << "Invalid Level ID: setting to 1 " << endl;
+            level_id = 1;
         }
-        else if (current_level == &level_2) {
-            return 2;
-        }
-        else if (current_level == &level_3) {
-            return 3;
-        }
-        else if (current_level == &level_4) {
-            return 4;
-        }
-        else if (current_level == &level_5) {
-            return 5;
-        }
-        else if (current_level == &level_6) {
-            return 6;
-        }
-        else if (current_level == &level_7) {
-            return 7;
+        vector<game_object*>& objects = get_built_level(level_id);
+        if (!has_player_first(objects)) {
+            cout << "Error loading level " << level_id << ": the first object has to be the player" << endl;
+            //Not kept, so the file is read again the next time the level is needed (once it's fixed)
+            delete_objects(objects);
+            built_levels.erase(level_id);
+            if (!current_level && level_id != 1)
+                return set_current_level(1);
+            return false;
         }
-        else if (current_level == &level_8) {
-            return 8;
+        current_level = &objects;
+        current_level_id = level_id;
+        capture_level_start();
+        register_animations();
+        rebuild_entities();
+        rebuild_broadphase();
+        //The new entities start out of play, so start with everything in the pool and put the active objects back into play
+        active_objects.clear();
+        inactive_objects.clear();
+        list_positions.clear();
+        for (size_t i = 0; i < current_level->size(); i++) {
+            list_positions.push_back(i);
+            inactive_objects.push_back(i);
         }
-        else if (current_level == &level_9) {
-            return 9;
+        spatial_index.clear();
+        spatial_proxies.assign(current_level->size(), -1);
+        sync_active_objects();
+        //Start building the level after this one so switching to it doesn't have to wait
+        prefetch_next_level();
+        return true;
+    }
+
+    //Switches level if one was asked for this tick. Call at the end of the tick, once nothing is using the old level anymore
+    //Returns true if the level changed
+    bool apply_level_switch() {
+        if (pending_level_id == 0)
+            return false;
+        int level_id = pending_level_id;
+        pending_level_id = 0;
+        return set_current_level(level_id);
+    }
+
+    //Plays objects that didn't come from a level file (the benchmarks' made up levels, see benchmarks.h) as level level_id
+    //The level manager owns the objects from then on. Use an id past get_level_count() so no level file is replaced
+    void set_custom_level(int level_id, vector<game_object*> objects) {
+        if (prefetch_level_id == level_id)
+            finish_prefetch();
+        vector<game_object*> old_objects = move(built_levels[level_id]);
+        built_levels[level_id] = move(objects);
+        level_starts.erase(level_id);
+        if (level_id == current_level_id)
+            current_start = nullptr;
+        set_current_level(level_id);
+        delete_objects(old_objects);
+    }
+
+    //Rebuilds a level from its file, for when the file changes while the game is running
+    //The current level is swapped for the new one straight away. Other built levels are thrown away and rebuilt when they're next needed
+    void reload_level(int level_id) {
+        if (prefetch_level_id == level_id)
+            finish_prefetch();
+        level_revisions[level_id]++;
+        auto found = built_levels.find(level_id);
+        if (found == built_levels.end())
+            return;
+        if (level_id != current_level_id) {
+            delete_objects(found->second);
+            built_levels.erase(found);
+            level_starts.erase(level_id);
+            //It may have been the level being prefetched, so start building it again from the new file
+            prefetch_next_level();
+            return;
         }
-        else if (current_level == &level_10) {
-            return 10;
+
+        //A half saved file could be missing the player, so keep playing the old version until it's fixed
+        vector<game_object*> objects = build_level(level_id);
+        if (!has_player_first(objects)) {
+            cout << "Level " << level_id << " not reloaded: the first object has to be the player" << endl;
+            delete_objects(objects);
+            return;
         }
-        return 1;
+        vector<game_object*> old_objects = move(found->second);
+        found->second = move(objects);
+        //How the old objects started doesn't apply to the new ones
+        level_starts.erase(level_id);
+        current_start = nullptr;
+        set_current_level(level_id);
+        delete_objects(old_objects);
+        cout << "Reloaded level " << level_id << endl;
     }
-    //Setters
-    void set_current_level(int level_id) {
-        switch (level_id) {
-        case 1:
-            current_level = &level_1;
-            break;
-        case 2:
-            current_level = &level_2;
-            break;
-        case 3:
-            current_level = &level_3;
-            break;
-        case 4:
-            current_level = &level_4;
-            break;
-        case 5:
-            current_level = &level_5;
-            break;
-        case 6:
-            current_level = &level_6;
-            break;
-        case 7:
-            current_level = &level_7;
-            break;
-        case 8:
-            current_level = &level_8;
-            break;
-        case 9:
-            current_level = &level_9;
-            break;
-        case 10:
-            current_level = &level_10;
-            break;
-        case 11:
-            current_level = &end_screen;
-            break;
-
-        default:
-            cout << "Invalid Level ID: setting to 1 " << endl;
-            current_level = &level_1;
-            break;
+
+    //The file a level is loaded from
+    static string get_level_file(int level_id) {
+        return "levels/level_" + to_string(level_id) + ".txt";
+    }
+
+    //The level a file belongs to (0 if it isn't a level file)
+    static int get_level_id(const string& file_name) {
+        for (int level_id = 1; level_id <= level_count; level_id++) {
+            if (get_level_file(level_id) == file_name)
+                return level_id;
         }
+        return 0;
+    }
+
+    //Lets the level manager spread work over a shared job system
+    void set_job_system(job_system* jobs) { this->jobs = jobs; }
+
+    //How many movers it takes for contact generation to go onto the job system. 0 forces it onto the job system on every level
+    //(the parallel collision self check uses that to compare it with the one thread path, see benchmarks.h)
+    static const size_t default_parallel_collision_threshold = 64; //Fewer movers than this isn't worth waking the workers for
+    void set_parallel_collision_threshold(size_t threshold) { parallel_collision_threshold = threshold; }
+
+    //Switch between the brute force and sweep and prune broadphases
+    void set_broadphase(broadphase_type new_broadphase) {
+        broadphase = new_broadphase;
+        if (current_level)
+            rebuild_broadphase();
+    }
+    broadphase_type get_broadphase() {
+        return broadphase;
     }
 };
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include <cstring>
+#include <type_traits>
+using namespace std;
+
+//Writes an object's dynamic state as raw bytes. Only plain values (floats, ints, bools, plain structs) go in
+class state_writer {
+private:
+    vector<char>& data;
+public:
+    //Constructor
+    state_writer(vector<char>& data) : data(data) {}
+
+    template <typename T>
+    void write(const T& value) {
+        static_assert(is_trivially_copyable<T>::value, "Only plain values can be written to a snapshot");
+        size_t position = data.size();
+        data.resize(position + sizeof(T));
+        memcpy(data.data() + position, &value, sizeof(T));
+    }
+};
+
+//Reads state back in the order it was written. Once a read runs off the end every read after it fails too
+class state_reader {
+private:
+    const char* data;
+    size_t size;
+    size_t position = 0;
+    bool failed = false;
+public:
+    //Constructors
+    state_reader(const vector<char>& data) : data(data.data()), size(data.size()) {}
+    state_reader(const char* data, size_t size) : data(data), size(size) {}
+
+    template <typename T>
+    bool read(T& value) {
+        static_assert(is_trivially_copyable<T>::value, "Only plain values can be read from a snapshot");
+        if (failed || size - position < sizeof(T)) {
+            failed = true;
+            return false;
+        }
+        memcpy(&value, data + position, sizeof(T));
+        position += sizeof(T);
+        return true;
+    }
+
+    //Whether every read worked and nothing was left over
+    bool is_complete() const { return !failed && position == size; }
+    bool has_failed() const { return failed; }
+};
+
+//Everything that changes while a level is played (positions, velocities, timers, health, which pickups are collected, ...)
+//Objects aren't copied, only their state, so capturing or restoring one is a walk over the level writing or reading a few bytes per object
+//Only valid for the level (and the version of its level file) it was captured from
+struct level_snapshot {
+    int level_id = 0; //0 if nothing has been captured
+    int level_revision = 0; //Which build of the level it came from (see level_manager::reload_level)
+    size_t object_count = 0;
+    vector<char> data;
+
+    bool is_empty() const { return level_id == 0; }
+};
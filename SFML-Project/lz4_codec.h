@@ -0,0 +1,142 @@
+#pragma once
+#include <vector>
+#include <cstring>
+#include <cstdint>
+using namespace std;
+
+//LZ4 block compression (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md)
+//Just the raw block format: the caller stores the original size so decompression knows how much to expect
+//The compressor is a simple greedy one. It's only run when building the asset pack, decompression is what has to be fast
+
+namespace lz4_detail {
+    const size_t min_match = 4;
+    const size_t last_literals = 5; //The last 5 bytes of a block are always literals
+    const size_t match_start_limit = 12; //The last match has to start at least 12 bytes before the end
+    const int hash_bits = 16;
+
+    inline uint32_t read32(const unsigned char* p) {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    inline uint32_t hash_sequence(uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - hash_bits);
+    }
+    //Lengths of 15 or more spill into extra bytes of 255s
+    inline void write_length(vector<char>& out, size_t length) {
+        while (length >= 255) {
+            out.push_back((char)255);
+            length -= 255;
+        }
+        out.push_back((char)length);
+    }
+    inline void write_sequence(vector<char>& out, const unsigned char* literals, size_t literal_count, size_t offset, size_t match_length) {
+        size_t match_code = match_length - min_match;
+        unsigned char token = (unsigned char)((literal_count >= 15 ? 15 : literal_count) << 4);
+        if (match_length > 0)
+            token |= (unsigned char)(match_code >= 15 ? 15 : match_code);
+        out.push_back((char)token);
+        if (literal_count >= 15)
+            write_length(out, literal_count - 15);
+        out.insert(out.end(), literals, literals + literal_count);
+        if (match_length == 0)
+            return;
+        out.push_back((char)(offset & 0xFF));
+        out.push_back((char)(offset >> 8));
+        if (match_code >= 15)
+            write_length(out, match_code - 15);
+    }
+}
+
+//Compresses size bytes into an LZ4 block
+inline vector<char> lz4_compress(const void* source, size_t size) {
+    using namespace lz4_detail;
+    const unsigned char* src = static_cast<const unsigned char*>(source);
+    vector<char> out;
+    out.reserve(size + size / 255 + 16);
+
+    vector<int64_t> table(size_t(1) << hash_bits, -1); //Last position each hashed 4 bytes were seen at
+    size_t anchor = 0; //Start of the literals not written yet
+    size_t position = 0;
+    while (size >= match_start_limit && position + match_start_limit <= size) {
+        uint32_t sequence = read32(src + position);
+        uint32_t slot = hash_sequence(sequence);
+        int64_t candidate = table[slot];
+        table[slot] = (int64_t)position;
+        if (candidate < 0 || position - (size_t)candidate > 65535 || read32(src + candidate) != sequence) {
+            position++;
+            continue;
+        }
+
+        //Extend the match as far as it goes (but never into the last literals)
+        size_t length = min_match;
+        while (position + length < size - last_literals && src[candidate + length] == src[position + length]) {
+            length++;
+        }
+        write_sequence(out, src + anchor, position - anchor, position - (size_t)candidate, length);
+        position += length;
+        anchor = position;
+    }
+    write_sequence(out, src + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+//Decompresses an LZ4 block into exactly destination_size bytes. Returns false if the block is corrupt
+inline bool lz4_decompress(const void* source, size_t source_size, void* destination, size_t destination_size) {
+    const unsigned char* in = static_cast<const unsigned char*>(source);
+    const unsigned char* in_end = in + source_size;
+    unsigned char* out = static_cast<unsigned char*>(destination);
+    unsigned char* out_start = out;
+    unsigned char* out_end = out + destination_size;
+
+    while (in < in_end) {
+        unsigned char token = *in++;
+
+        //Literals
+        size_t literal_count = token >> 4;
+        if (literal_count == 15) {
+            unsigned char extra;
+            do {
+                if (in >= in_end) return false;
+                extra = *in++;
+                literal_count += extra;
+            } while (extra == 255);
+        }
+        if ((size_t)(in_end - in) < literal_count || (size_t)(out_end - out) < literal_count)
+            return false;
+        if (literal_count > 0)
+            memcpy(out, in, literal_count);
+        in += literal_count;
+        out += literal_count;
+
+        //The last sequence is only literals
+        if (in == in_end)
+            break;
+
+        //Match
+        if (in_end - in < 2) return false;
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        if (offset == 0 || offset > (size_t)(out - out_start))
+            return false;
+        size_t match_length = (token & 15);
+        if (match_length == 15) {
+            unsigned char extra;
+            do {
+                if (in >= in_end) return false;
+                extra = *in++;
+                match_length += extra;
+            } while (extra == 255);
+        }
+        match_length += lz4_detail::min_match;
+        if ((size_t)(out_end - out) < match_length)
+            return false;
+        //Byte by byte, because the match can overlap what it's writing (that's how runs are stored)
+        const unsigned char* match = out - offset;
+        for (size_t i = 0; i < match_length; i++) {
+            out[i] = match[i];
+        }
+        out += match_length;
+    }
+    return out == out_end;
+}
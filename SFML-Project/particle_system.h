@@ -0,0 +1,179 @@
+#pragma once
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+using namespace std;
+
+//SFML files
+#include "SFML/Graphics.hpp"
+//SFML namespace
+using namespace sf;
+
+//Our files
+#include "job_system.h"
+
+//Particle effects (explosions, pickups, jumps)
+//Particles are stored as flat arrays (one per field) in a fixed size ring buffer, so a burst never allocates mid-frame.
+//When the buffer is full the oldest particles are overwritten
+//Only the live part of the ring (from the oldest particle that might still be alive up to the newest) is updated and drawn,
+//so a dozen particles cost a dozen particles' work, not a walk over the whole buffer
+class particle_system {
+private:
+    int capacity;
+    int next_particle = 0; //Ring buffer write position
+    int live_count = 0; //How many slots before next_particle may hold live particles
+
+    //Particle fields
+    vector<float> x_positions;
+    vector<float> y_positions;
+    vector<float> x_velocities;
+    vector<float> y_velocities;
+    vector<float> life_left; //Seconds left to live (dead if <= 0)
+    vector<float> lifetimes; //Seconds the particle lived for in total (used for fading)
+    vector<Color> colors;
+
+    float gravity = 900; //Downwards acceleration in pixels per second squared
+    size_t parallel_chunk_size = 8192; //Particles per job when updating on the job system
+    size_t parallel_threshold = 16384; //Fewer live particles than this are updated on the calling thread
+    float particle_size = 4; //Width and height of each particle quad
+
+    mt19937 random_engine;
+
+public:
+    //Constructor. All particle memory is allocated here
+    particle_system(int capacity = 50000) : capacity(capacity), random_engine(random_device{}()) {
+        x_positions.resize(capacity);
+        y_positions.resize(capacity);
+        x_velocities.resize(capacity);
+        y_velocities.resize(capacity);
+        life_left.resize(capacity, 0);
+        lifetimes.resize(capacity, 1);
+        colors.resize(capacity);
+    }
+
+    //Spawn a burst of particles flying out of a point in random directions
+    void emit(Vector2f position, int count, Color color, float speed, float lifetime) {
+        uniform_real_distribution<float> random_angle(0, 6.2831853f);
+        uniform_real_distribution<float> random_scale(0.25f, 1);
+
+        for (int i = 0; i < count; i++) {
+            int p = next_particle;
+            next_particle = (next_particle + 1) % capacity;
+
+            float angle = random_angle(random_engine);
+            float particle_speed = speed * random_scale(random_engine);
+            x_positions[p] = position.x;
+            y_positions[p] = position.y;
+            x_velocities[p] = cos(angle) * particle_speed;
+            y_velocities[p] = sin(angle) * particle_speed;
+            lifetimes[p] = lifetime * random_scale(random_engine);
+            life_left[p] = lifetimes[p];
+            colors[p] = color;
+        }
+        live_count = min(capacity, live_count + count);
+    }
+
+    //The first slot of the live part of the ring
+    int get_oldest_particle() {
+        return (next_particle - live_count + capacity) % capacity;
+    }
+
+    //Calls func(first, last) for the slots of the live part of the ring from first to last (counted from the oldest).
+    //The ring wraps, so that's up to two ranges of slots
+    template <typename F>
+    void for_live_slots(size_t first, size_t last, F& func) {
+        size_t start = (get_oldest_particle() + first) % capacity;
+        size_t count = last - first;
+        size_t before_wrap = min(count, capacity - start);
+        func(start, start + before_wrap);
+        if (before_wrap < count)
+            func(0, count - before_wrap);
+    }
+
+    //Move every live particle. The loop has no branches so the compiler can vectorize it
+    //Lots of particles are split into chunks and updated on the job system if one is given
+    void update(float delta, job_system* jobs = nullptr) {
+        if (live_count == 0)
+            return;
+
+        float* x = x_positions.data();
+        float* y = y_positions.data();
+        float* x_velocity = x_velocities.data();
+        float* y_velocity = y_velocities.data();
+        float* life = life_left.data();
+        float gravity_step = gravity * delta;
+
+        auto update_range = [=](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++) {
+                y_velocity[i] += gravity_step;
+                x[i] += x_velocity[i] * delta;
+                y[i] += y_velocity[i] * delta;
+                life[i] -= delta;
+            }
+        };
+        auto update_live_range = [&](size_t first, size_t last) {
+            for_live_slots(first, last, update_range);
+        };
+        if (jobs && (size_t)live_count >= parallel_threshold)
+            jobs->parallel_for(live_count, parallel_chunk_size, update_live_range);
+        else
+            update_live_range(0, live_count);
+
+        //Particles die roughly in the order they were made, so the live part shrinks from its oldest end
+        while (live_count > 0 && life_left[get_oldest_particle()] <= 0) {
+            live_count--;
+        }
+    }
+
+    //Append a quad for every live particle. Particles fade out over their lifetime
+    //Room for every quad is made up front and filled in place, rather than appending vertices one at a time
+    void build_vertices(VertexArray& quads) {
+        float half_size = particle_size / 2;
+        size_t first_vertex = quads.getVertexCount();
+        quads.resize(first_vertex + (size_t)live_count * 4);
+        if (live_count == 0)
+            return;
+        //The vertices are stored contiguously, so they're written through a pointer (no call per vertex)
+        Vertex* vertices = &quads[first_vertex];
+        size_t vertex = 0;
+        int oldest = get_oldest_particle();
+        for (int k = 0; k < live_count; k++) {
+            int i = (oldest + k) % capacity;
+            if (life_left[i] <= 0)
+                continue;
+
+            Color color = colors[i];
+            color.a = static_cast<Uint8>(color.a * (life_left[i] / lifetimes[i]));
+            float left = x_positions[i] - half_size;
+            float top = y_positions[i] - half_size;
+            Vector2f corners[4] = {
+                Vector2f(left, top),
+                Vector2f(left + particle_size, top),
+                Vector2f(left + particle_size, top + particle_size),
+                Vector2f(left, top + particle_size)
+            };
+            for (int corner = 0; corner < 4; corner++) {
+                vertices[vertex].position = corners[corner];
+                vertices[vertex].color = color;
+                vertex++;
+            }
+        }
+        //Dead particles in the live part didn't use their room
+        quads.resize(first_vertex + vertex);
+    }
+
+    //Kill every particle (used when the level changes or time jumps)
+    void clear() {
+        auto kill_range = [this](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++) {
+                life_left[i] = 0;
+            }
+        };
+        for_live_slots(0, live_count, kill_range);
+        live_count = 0;
+    }
+
+    int get_capacity() { return capacity; }
+    int get_live_count() { return live_count; }
+};
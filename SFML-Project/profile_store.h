@@ -0,0 +1,371 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+using namespace std;
+
+//Our files
+#include "save_file.h"
+#include "mapped_file.h"
+
+//Every player's save, kept in two files:
+//  profiles.sav: a 128 byte header ("SPRF", version (u32), zero padding) then one slot per player, in the order they were created
+//  profiles.idx: "SIDX", version (u32), entry count (u32), padding (u32), then per player: name (32 bytes, zero padded), slot (u32), padding (u32), sorted by name
+//A slot holds two copies of the player's save, each 128 bytes: a save record (see save_file.h), a sequence number (u32), a CRC-32 of both (u32), zero padding
+//The header is padded to the size of a copy, so every copy starts on a 128 byte boundary and none of them crosses a 512 byte disk sector
+//The index is memory mapped and binary searched, so finding a player reads a handful of entries however many players there are
+//Slots never move. Saving an existing player overwrites the older of its two copies with a higher sequence number, and reading takes the newest copy
+//that's intact, so a save cut short by a crash or power cut leaves the previous one to fall back on (a sector can be torn on some disks)
+//Only adding a player rewrites the index (written to a temporary file and swapped in, like the single save). The records are what counts:
+//if the index is missing or doesn't match them, it's rebuilt from them when the store is opened
+//Older stores are upgraded when they're opened: version 1 had one 64 byte record per player (overwritten in place), version 2 had a 64 byte header
+//Safe to use from several threads at once
+class profile_store {
+private:
+    string records_path;
+    string index_path;
+    mapped_file index;
+    uint32_t record_count = 0;
+    mutex store_mutex;
+
+    static const uint32_t version = 3;
+    static const size_t copy_size = 128; //One copy of a save
+    static const size_t header_size = copy_size; //Keeps every copy aligned to its size
+    static const size_t old_header_size = 64; //Versions 1 and 2
+    static const size_t slot_size = 2 * copy_size;
+    static const size_t sequence_offset = save_file::record_size;
+    static const size_t copy_checksum_offset = sequence_offset + 4;
+    static const size_t index_header_size = 16;
+    static const size_t index_entry_size = 40;
+    static const size_t key_size = save_file::max_name_length;
+
+    //A name as it's stored in the index: zero padded to 32 bytes, so names compare with one memcmp. Longer names aren't allowed (see save())
+    struct index_key {
+        char name[key_size];
+    };
+    struct index_entry {
+        index_key key;
+        uint32_t slot = 0;
+    };
+
+    static index_key make_key(const string& player_name) {
+        index_key key;
+        memset(key.name, 0, key_size);
+        memcpy(key.name, player_name.data(), player_name.size() < key_size ? player_name.size() : key_size);
+        return key;
+    }
+
+    static void write_value(char* out, uint32_t value) {
+        for (size_t i = 0; i < 4; i++) {
+            out[i] = (char)((value >> (8 * i)) & 0xFF);
+        }
+    }
+    static uint32_t read_value(const char* data) {
+        uint32_t value = 0;
+        for (size_t i = 0; i < 4; i++) {
+            value |= (uint32_t)(unsigned char)data[i] << (8 * i);
+        }
+        return value;
+    }
+
+    static uint64_t get_slot_offset(uint32_t slot) { return header_size + (uint64_t)slot * slot_size; }
+
+    //Fills in a copy of a save
+    static void encode_copy(const save_record& record, uint32_t sequence, char* data) {
+        memset(data, 0, copy_size);
+        save_file::encode(record, data);
+        write_value(data + sequence_offset, sequence);
+        write_value(data + copy_checksum_offset, save_crc32(data, copy_checksum_offset));
+    }
+    //Reads a copy back. Returns false if it's damaged (or was never written)
+    static bool decode_copy(const char* data, save_record& out, uint32_t& sequence) {
+        if (read_value(data + copy_checksum_offset) != save_crc32(data, copy_checksum_offset) || !save_file::decode(data, out))
+            return false;
+        sequence = read_value(data + sequence_offset);
+        return true;
+    }
+
+    //Which of a slot's copies holds its newest intact save (-1 if neither is intact)
+    static int get_newest_copy(const char* slot_data, save_record& out, uint32_t& sequence) {
+        save_record copies[2];
+        uint32_t sequences[2] = {};
+        bool intact[2];
+        for (int copy = 0; copy < 2; copy++) {
+            intact[copy] = decode_copy(slot_data + copy * copy_size, copies[copy], sequences[copy]);
+        }
+        int newest = -1;
+        if (intact[0] && intact[1])
+            newest = (int32_t)(sequences[1] - sequences[0]) > 0 ? 1 : 0; //Carries on working if the sequence ever wraps around
+        else if (intact[0] || intact[1])
+            newest = intact[0] ? 0 : 1;
+        if (newest >= 0) {
+            out = copies[newest];
+            sequence = sequences[newest];
+        }
+        return newest;
+    }
+
+    uint32_t get_index_count() const {
+        return index.get_data() ? read_value(index.get_data() + 8) : 0;
+    }
+    const char* get_index_entry(uint32_t position) const {
+        return index.get_data() + index_header_size + (size_t)position * index_entry_size;
+    }
+
+    //Binary search of the mapped index. Returns the first position whose name isn't before the key
+    uint32_t lower_bound(const index_key& key) const {
+        uint32_t first = 0, count = get_index_count();
+        while (count > 0) {
+            uint32_t step = count / 2;
+            if (memcmp(get_index_entry(first + step), key.name, key_size) < 0) {
+                first += step + 1;
+                count -= step + 1;
+            }
+            else {
+                count = step;
+            }
+        }
+        return first;
+    }
+
+    bool read_slot(uint32_t slot, char* data) const {
+        ifstream reader(records_path, ios::binary);
+        reader.seekg((streamoff)get_slot_offset(slot));
+        return (bool)reader.read(data, slot_size);
+    }
+
+    bool read_record(uint32_t slot, save_record& out) const {
+        char data[slot_size];
+        uint32_t sequence;
+        return read_slot(slot, data) && get_newest_copy(data, out, sequence) >= 0;
+    }
+
+    //Rewrites an older store in the current layout. The old file is only replaced once the new one is on the disk
+    //Version 1 slots are a single record, version 2 slots are already two copies (the newest intact one is kept)
+    bool upgrade_records(ifstream& reader, uint64_t size, uint32_t file_version) {
+        size_t old_slot_size = file_version == 1 ? save_file::record_size : slot_size;
+        uint32_t count = (uint32_t)((size - old_header_size) / old_slot_size);
+        vector<char> data(header_size + (size_t)count * slot_size, 0);
+        memcpy(data.data(), "SPRF", 4);
+        write_value(data.data() + 4, version);
+        for (uint32_t slot = 0; slot < count; slot++) {
+            char old_slot[slot_size];
+            save_record record;
+            uint32_t sequence = 0;
+            reader.seekg((streamoff)(old_header_size + (uint64_t)slot * old_slot_size));
+            bool intact = reader.read(old_slot, old_slot_size)
+                && (file_version == 1 ? save_file::decode(old_slot, record) : get_newest_copy(old_slot, record, sequence) >= 0);
+            //Damaged records stay damaged (both copies left empty) so the slots keep their numbers
+            if (intact)
+                encode_copy(record, sequence + 1, data.data() + get_slot_offset(slot));
+        }
+        reader.close();
+
+        string temporary_path = records_path + ".tmp";
+        if (!save_file::write_durably(temporary_path, data.data(), data.size()) || !save_file::replace_file(temporary_path, records_path)) {
+            cout << "Error upgrading profiles: " << records_path << endl;
+            remove(temporary_path.c_str());
+            return false;
+        }
+        record_count = count;
+        cout << "Upgraded profiles (" << count << " profiles)" << endl;
+        return true;
+    }
+
+    //Writes the index out and maps the new one
+    bool write_index(const vector<index_entry>& entries) {
+        vector<char> data(index_header_size + entries.size() * index_entry_size, 0);
+        memcpy(data.data(), "SIDX", 4);
+        write_value(data.data() + 4, version);
+        write_value(data.data() + 8, (uint32_t)entries.size());
+        for (size_t i = 0; i < entries.size(); i++) {
+            char* entry = data.data() + index_header_size + i * index_entry_size;
+            memcpy(entry, entries[i].key.name, key_size);
+            write_value(entry + key_size, entries[i].slot);
+        }
+
+        string temporary_path = index_path + ".tmp";
+        if (!save_file::write_durably(temporary_path, data.data(), data.size())) {
+            cout << "Error writing profile index: " << temporary_path << endl;
+            return false;
+        }
+        //Windows won't replace a file that's mapped
+        index.close();
+        if (!save_file::replace_file(temporary_path, index_path)) {
+            cout << "Error replacing profile index: " << index_path << endl;
+            remove(temporary_path.c_str());
+            index.open(index_path);
+            return false;
+        }
+        return index.open(index_path);
+    }
+
+    //Rebuilds the index by reading every record. Only needed if the game stopped while adding a player
+    bool rebuild_index() {
+        vector<index_entry> entries;
+        for (uint32_t slot = 0; slot < record_count; slot++) {
+            save_record record;
+            if (!read_record(slot, record)) {
+                cout << "Profile " << slot << " is damaged" << endl;
+                continue;
+            }
+            index_entry entry;
+            entry.key = make_key(record.player_name);
+            entry.slot = slot;
+            auto position = entries.begin();
+            while (position != entries.end() && memcmp(position->key.name, entry.key.name, key_size) < 0) {
+                position++;
+            }
+            //Two records for the same name can only happen if adding one was cut short. The newer one wins
+            if (position != entries.end() && memcmp(position->key.name, entry.key.name, key_size) == 0)
+                position->slot = slot;
+            else
+                entries.insert(position, entry);
+        }
+        cout << "Rebuilt profile index (" << entries.size() << " profiles)" << endl;
+        return write_index(entries);
+    }
+
+    bool is_index_valid() const {
+        if (!index.get_data() || index.get_size() < index_header_size || memcmp(index.get_data(), "SIDX", 4) != 0 || read_value(index.get_data() + 4) != version)
+            return false;
+        uint32_t count = get_index_count();
+        if ((index.get_size() - index_header_size) / index_entry_size < count || count > record_count)
+            return false;
+        for (uint32_t i = 0; i < count; i++) {
+            if (read_value(get_index_entry(i) + key_size) >= record_count)
+                return false;
+        }
+        return true;
+    }
+
+public:
+    //Constructor (default)
+    profile_store() = default;
+    profile_store(const profile_store&) = delete;
+    profile_store& operator=(const profile_store&) = delete;
+
+    //Opens the store (path without an extension). Creates it if it doesn't exist
+    bool open(const string& path) {
+        lock_guard<mutex> lock(store_mutex);
+        records_path = path + ".sav";
+        index_path = path + ".idx";
+
+        ifstream reader(records_path, ios::binary | ios::ate);
+        if (!reader.is_open()) {
+            char header[header_size] = {};
+            memcpy(header, "SPRF", 4);
+            write_value(header + 4, version);
+            if (!save_file::write_durably(records_path, header, header_size)) {
+                cout << "Error creating profiles: " << records_path << endl;
+                return false;
+            }
+            record_count = 0;
+            return write_index(vector<index_entry>());
+        }
+        else {
+            uint64_t size = (uint64_t)reader.tellg();
+            char header[8] = {};
+            reader.seekg(0);
+            uint32_t file_version = 0;
+            if (size >= old_header_size && reader.read(header, 8) && memcmp(header, "SPRF", 4) == 0)
+                file_version = read_value(header + 4);
+            if (file_version == 1 || file_version == 2) {
+                //The old index is rebuilt below (it has the old version)
+                if (!upgrade_records(reader, size, file_version))
+                    return false;
+            }
+            else if (file_version != version || size < header_size) {
+                cout << "Error reading profiles: " << records_path << endl;
+                return false;
+            }
+            else {
+                //A slot that was only partly added is ignored, and overwritten by the next one
+                record_count = (uint32_t)((size - header_size) / slot_size);
+            }
+        }
+
+        //Every record is indexed unless the game stopped part way through adding one
+        index.open(index_path);
+        if (!is_index_valid() || get_index_count() < record_count)
+            return rebuild_index();
+        return true;
+    }
+
+    //Finds a player's save. Returns false if there isn't one
+    bool find(const string& player_name, save_record& out) {
+        lock_guard<mutex> lock(store_mutex);
+        if (player_name.size() > key_size)
+            return false;
+        index_key key = make_key(player_name);
+        uint32_t position = lower_bound(key);
+        if (position >= get_index_count() || memcmp(get_index_entry(position), key.name, key_size) != 0)
+            return false;
+        if (!read_record(read_value(get_index_entry(position) + key_size), out)) {
+            cout << "Profile for " << player_name << " is damaged" << endl;
+            return false;
+        }
+        return true;
+    }
+
+    //Saves a player. Existing players have their older copy replaced, new ones are added
+    //Names longer than get_max_name_length() are refused rather than cut short, so two players can never end up sharing a save
+    bool save(const save_record& record) {
+        lock_guard<mutex> lock(store_mutex);
+        if (record.player_name.size() > key_size) {
+            cout << "Can't save profile for " << record.player_name << ": names can be at most " << key_size << " characters" << endl;
+            return false;
+        }
+        index_key key = make_key(record.player_name);
+        uint32_t position = lower_bound(key);
+        if (position < get_index_count() && memcmp(get_index_entry(position), key.name, key_size) == 0) {
+            uint32_t slot = read_value(get_index_entry(position) + key_size);
+            char slot_data[slot_size];
+            save_record newest;
+            uint32_t sequence = 0;
+            int newest_copy = read_slot(slot, slot_data) ? get_newest_copy(slot_data, newest, sequence) : -1;
+            //Write over whichever copy isn't the newest intact one
+            int copy = newest_copy == 0 ? 1 : 0;
+            char data[copy_size];
+            encode_copy(record, sequence + 1, data);
+            if (!save_file::write_at(records_path, get_slot_offset(slot) + copy * copy_size, data, copy_size)) {
+                cout << "Error saving profile for " << record.player_name << endl;
+                return false;
+            }
+            return true;
+        }
+
+        //New player: add the slot (the save in its first copy), then the index entry
+        uint32_t slot = record_count;
+        char data[slot_size];
+        memset(data, 0, slot_size);
+        encode_copy(record, 1, data);
+        if (!save_file::write_at(records_path, get_slot_offset(slot), data, slot_size)) {
+            cout << "Error adding profile for " << record.player_name << endl;
+            return false;
+        }
+        record_count++;
+        vector<index_entry> entries(get_index_count() + 1);
+        for (uint32_t i = 0, j = 0; i < entries.size(); i++) {
+            if (i == position) {
+                entries[i].key = key;
+                entries[i].slot = slot;
+                continue;
+            }
+            memcpy(entries[i].key.name, get_index_entry(j), key_size);
+            entries[i].slot = read_value(get_index_entry(j) + key_size);
+            j++;
+        }
+        return write_index(entries);
+    }
+
+    uint32_t get_profile_count() {
+        lock_guard<mutex> lock(store_mutex);
+        return get_index_count();
+    }
+    static size_t get_max_name_length() { return key_size; }
+};
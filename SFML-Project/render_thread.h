@@ -0,0 +1,204 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+using namespace std;
+
+//SFML files
+#include "SFML/Graphics.hpp"
+#include "SFML/Window.hpp"
+#include "SFML/System.hpp"
+//SFML namespace
+using namespace sf;
+
+//Our files
+#include "frame_pacer.h"
+
+//Everything the renderer needs to draw one frame. Built by the simulation and never touched again once published
+struct draw_list {
+    VertexArray shapes = VertexArray(Quads); //Every visible filled shape, batched into one vertex array
+    vector<Sprite> sprites; //Sprites in draw order
+    VertexArray particles = VertexArray(Quads); //Every live particle, batched into one vertex array
+    VertexArray debug_overlay = VertexArray(Lines); //Hitbox outlines (empty when the overlay is off)
+    Uint64 tick = 0; //Which simulation tick this frame shows (set by publish())
+
+    //Empty the list but keep the memory so the next frame doesn't allocate
+    void clear() {
+        shapes.clear();
+        sprites.clear();
+        particles.clear();
+        debug_overlay.clear();
+    }
+};
+
+//Draws frames on its own thread so a slow window.display() (vsync, framerate limit) never holds up input or the simulation
+//The simulation fills the write buffer and publishes it, the render thread always draws the newest published frame (triple buffering)
+class render_thread {
+private:
+    RenderWindow* window = nullptr;
+    const Sprite* background = nullptr;
+
+    //Three buffers so the simulation never waits on the renderer: one being written, one ready, one being drawn
+    draw_list buffers[3];
+    int write_index = 0;
+    int ready_index = 1;
+    int read_index = 2;
+    bool has_new_frame = false;
+    bool has_any_frame = false;
+    Uint64 published_ticks = 0;
+
+    //Frame pacing. Only used on the render thread, except for the stats which are guarded by stats_mutex
+    frame_pacer pacer;
+    pacing_mode initial_mode = pacing_precise;
+    atomic<int> requested_mode{ -1 }; //Mode change asked for by another thread (-1 if none)
+    mutex stats_mutex;
+
+    //Work that needs the window's OpenGL context (texture uploads), run at the start of the next frame
+    mutex task_mutex;
+    vector<function<void()>> render_tasks;
+    vector<function<void()>> running_tasks;
+
+    mutex buffer_mutex;
+    condition_variable frame_ready;
+    atomic<bool> running{ false };
+    thread worker;
+
+    //Render loop. Runs on the render thread until stop() is called
+    void run() {
+        //The window's OpenGL context can only be active on one thread at a time
+        window->setActive(true);
+        pacer.set_mode(initial_mode, *window);
+
+        while (running) {
+            {
+                //Wait until the simulation has published at least one frame, then always draw the newest one
+                //Paced modes draw the last frame again if the simulation hasn't made a new one in time, to keep the display steady
+                //Uncapped waits for a new frame instead, otherwise it would spin redrawing the same frame
+                bool redraw_old_frames = pacer.get_mode() != pacing_uncapped;
+                unique_lock<mutex> lock(buffer_mutex);
+                frame_ready.wait(lock, [this, redraw_old_frames] { return has_new_frame || (has_any_frame && redraw_old_frames) || !running; });
+                if (!running)
+                    break;
+                if (has_new_frame) {
+                    swap(read_index, ready_index);
+                    has_new_frame = false;
+                }
+            }
+
+            {
+                lock_guard<mutex> lock(task_mutex);
+                running_tasks.swap(render_tasks);
+            }
+            for (function<void()>& task : running_tasks) {
+                task();
+            }
+            running_tasks.clear();
+
+            int new_mode = requested_mode.exchange(-1);
+            if (new_mode >= 0) {
+                lock_guard<mutex> lock(stats_mutex);
+                pacer.set_mode(static_cast<pacing_mode>(new_mode), *window);
+            }
+
+            pacer.begin_frame();
+            const draw_list& frame = buffers[read_index];
+            window->clear();
+            if (background)
+                window->draw(*background);
+            window->draw(frame.shapes);
+            for (const Sprite& sprite : frame.sprites) {
+                window->draw(sprite);
+            }
+            window->draw(frame.particles);
+            if (frame.debug_overlay.getVertexCount() > 0)
+                window->draw(frame.debug_overlay);
+
+            //Wait until it's time to show the frame, then display it (vsync waits inside display)
+            pacer.wait_for_next_frame();
+            window->display();
+            {
+                lock_guard<mutex> lock(stats_mutex);
+                pacer.end_frame(frame.tick);
+            }
+        }
+
+        window->setActive(false);
+    }
+
+public:
+    //Constructor (default)
+    render_thread() = default;
+    //Destructor
+    ~render_thread() { stop(); }
+
+    //Starts drawing to the window on the render thread. The calling thread must not draw to the window until stop() is called
+    void start(RenderWindow& window, const Sprite& background, pacing_mode mode) {
+        if (running) return;
+
+        this->window = &window;
+        this->background = &background;
+        initial_mode = mode;
+        //Release the context on this thread so the render thread can take it
+        window.setActive(false);
+        running = true;
+        worker = thread(&render_thread::run, this);
+    }
+
+    //Stops the render thread and gives the window's context back to the calling thread
+    void stop() {
+        if (!running) return;
+
+        {
+            lock_guard<mutex> lock(buffer_mutex);
+            running = false;
+        }
+        frame_ready.notify_one();
+        worker.join();
+        window->setActive(true);
+    }
+
+    //The buffer the simulation should build the next frame into
+    draw_list& get_write_buffer() {
+        return buffers[write_index];
+    }
+
+    //Hands the write buffer to the renderer. If the renderer hasn't picked up the previous frame yet it is replaced by this one
+    void publish() {
+        {
+            lock_guard<mutex> lock(buffer_mutex);
+            buffers[write_index].tick = ++published_ticks;
+            swap(write_index, ready_index);
+            has_new_frame = true;
+            has_any_frame = true;
+        }
+        frame_ready.notify_one();
+    }
+
+    //Runs a task on the render thread before it draws its next frame. Anything that touches OpenGL or something the renderer is drawing goes through here
+    void run_on_render_thread(function<void()> task) {
+        lock_guard<mutex> lock(task_mutex);
+        render_tasks.push_back(move(task));
+    }
+
+    //Ask the render thread to switch frame pacing mode (applied at the start of its next frame)
+    void set_pacing_mode(pacing_mode mode) {
+        requested_mode = mode;
+    }
+
+    pacing_mode get_pacing_mode() {
+        lock_guard<mutex> lock(stats_mutex);
+        return pacer.get_mode();
+    }
+
+    //Frame time statistics of the frames actually displayed
+    frame_stats get_frame_stats() {
+        lock_guard<mutex> lock(stats_mutex);
+        return pacer.get_stats();
+    }
+
+    bool is_running() { return running; }
+};
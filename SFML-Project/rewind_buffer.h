@@ -0,0 +1,226 @@
+#pragma once
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+using namespace std;
+
+//Our files
+#include "level_snapshot.h"
+#include "level_manager.h"
+
+//Remembers the last few seconds of play so time can be run backwards
+//Every tick's level snapshot is stored, but only every keyframe_interval-th one in full. The rest are stored as the difference from
+//their keyframe (XOR), with unchanged runs of bytes squeezed out. Most of a level doesn't move from tick to tick, so those are tiny
+//Any tick can be rebuilt from its keyframe and its own delta (no chain of deltas to replay)
+//Memory is capped: once the buffer is over its budget (or its length), the oldest keyframe and its deltas are dropped together
+class rewind_buffer {
+private:
+    struct frame {
+        int level_id = 0;
+        int level_revision = 0;
+        size_t object_count = 0;
+        size_t keyframe_distance = 0; //How many frames back this frame's keyframe is (0 for keyframes)
+        vector<char> bytes; //The snapshot for keyframes, the encoded delta otherwise
+    };
+
+    deque<frame> frames;
+    vector<vector<char>> spare_bytes; //Memory from dropped frames, reused so recording doesn't allocate once the buffer is full
+    level_snapshot scratch;
+
+    size_t max_frames;
+    size_t memory_budget; //Bytes
+    size_t keyframe_interval;
+    size_t used_bytes = 0; //Allocated by the stored frames (capacity, not size, so reused memory is counted honestly)
+
+    //Delta encoding: [unchanged byte count][changed byte count][changed bytes XOR keyframe] repeated. Counts are variable length (7 bits a byte)
+    static void write_count(vector<char>& out, size_t count) {
+        while (count >= 0x80) {
+            out.push_back((char)((count & 0x7F) | 0x80));
+            count >>= 7;
+        }
+        out.push_back((char)count);
+    }
+    static bool read_count(const vector<char>& in, size_t& position, size_t& count) {
+        count = 0;
+        for (int shift = 0; position < in.size() && shift < 64; shift += 7) {
+            unsigned char byte = (unsigned char)in[position++];
+            count |= (size_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    vector<char> take_spare_bytes() {
+        if (spare_bytes.empty())
+            return vector<char>();
+        vector<char> bytes = move(spare_bytes.back());
+        spare_bytes.pop_back();
+        bytes.clear();
+        return bytes;
+    }
+
+    void recycle(vector<char>& bytes) {
+        used_bytes -= bytes.capacity();
+        if (spare_bytes.size() < keyframe_interval)
+            spare_bytes.push_back(move(bytes));
+    }
+    void drop_front() {
+        recycle(frames.front().bytes);
+        frames.pop_front();
+    }
+    void drop_back() {
+        recycle(frames.back().bytes);
+        frames.pop_back();
+    }
+
+    //Drops the oldest keyframe and every delta that depends on it. Never drops the group being recorded into
+    bool drop_oldest_group() {
+        size_t group_size = 1;
+        while (group_size < frames.size() && frames[group_size].keyframe_distance != 0) {
+            group_size++;
+        }
+        if (group_size == frames.size())
+            return false;
+        for (size_t i = 0; i < group_size; i++) {
+            drop_front();
+        }
+        return true;
+    }
+
+    //Rebuilds the snapshot of a frame
+    bool decode(size_t index, level_snapshot& out) {
+        const frame& current = frames[index];
+        const frame& keyframe = frames[index - current.keyframe_distance];
+        out.level_id = current.level_id;
+        out.level_revision = current.level_revision;
+        out.object_count = current.object_count;
+        if (current.keyframe_distance == 0) {
+            out.data.assign(current.bytes.begin(), current.bytes.end());
+            return true;
+        }
+        return decode_delta(keyframe.bytes, current.bytes, out.data);
+    }
+
+public:
+    //Constructor. Keeps up to max_frames ticks, in at most memory_budget bytes, with a full snapshot every keyframe_interval ticks
+    rewind_buffer(size_t max_frames = 600, size_t memory_budget = 32 * 1024 * 1024, size_t keyframe_interval = 60)
+        : max_frames(max_frames), memory_budget(memory_budget), keyframe_interval(keyframe_interval) {}
+
+    //Stores this tick. Call once per tick, after the simulation has run
+    void record(level_manager& levels) {
+        levels.capture_snapshot(scratch);
+        if (scratch.is_empty())
+            return;
+
+        frame next;
+        next.level_id = scratch.level_id;
+        next.level_revision = scratch.level_revision;
+        next.object_count = scratch.object_count;
+        next.bytes = take_spare_bytes();
+
+        //A new keyframe every so often, and whenever the level changes (a delta only works against a snapshot of the same level)
+        bool needs_keyframe = frames.empty() || frames.back().keyframe_distance + 1 >= keyframe_interval;
+        if (!needs_keyframe) {
+            const frame& keyframe = frames[frames.size() - 1 - frames.back().keyframe_distance];
+            needs_keyframe = keyframe.level_id != next.level_id || keyframe.level_revision != next.level_revision
+                || keyframe.object_count != next.object_count || keyframe.bytes.size() != scratch.data.size();
+            if (!needs_keyframe) {
+                next.keyframe_distance = frames.back().keyframe_distance + 1;
+                encode_delta(keyframe.bytes, scratch.data, next.bytes);
+            }
+        }
+        if (needs_keyframe)
+            next.bytes.assign(scratch.data.begin(), scratch.data.end());
+
+        used_bytes += next.bytes.capacity();
+        frames.push_back(move(next));
+        while ((frames.size() > max_frames || used_bytes > memory_budget) && drop_oldest_group()) {
+        }
+    }
+
+    //Goes back a number of ticks and puts the level back how it was then. Returns false if there's nothing to go back to
+    //At the oldest tick the level stays paused there (returns true) rather than playing a tick and rewinding it again
+    //Play carries on from wherever rewinding stopped, and the ticks that were rewound over are forgotten
+    bool step_back(level_manager& levels, size_t ticks = 1) {
+        if (frames.empty())
+            return false;
+        if (frames.size() == 1)
+            return true;
+        for (size_t i = 0; i < ticks && frames.size() > 1; i++) {
+            drop_back();
+        }
+        if (!decode(frames.size() - 1, scratch) || !levels.restore_snapshot(scratch)) {
+            //The level was reloaded since (or the frame is broken), so nothing in the buffer is any use anymore
+            clear();
+            return false;
+        }
+        return true;
+    }
+
+    void clear() {
+        while (!frames.empty()) {
+            drop_back();
+        }
+    }
+
+    //The difference between a keyframe and a later snapshot of the same size (see the top of the class), and back again
+    static void encode_delta(const vector<char>& keyframe, const vector<char>& state, vector<char>& out) {
+        out.clear();
+        size_t size = state.size();
+        size_t position = 0;
+        while (position < size) {
+            //Skip unchanged bytes, 8 at a time where possible
+            size_t start = position;
+            while (position + 8 <= size && memcmp(keyframe.data() + position, state.data() + position, 8) == 0) {
+                position += 8;
+            }
+            while (position < size && keyframe[position] == state[position]) {
+                position++;
+            }
+            if (position == size)
+                break;
+            size_t unchanged = position - start;
+
+            //Then take changed bytes until there's a run of unchanged ones worth skipping
+            size_t changed_start = position;
+            size_t same_run = 0;
+            while (position < size && same_run < 8) {
+                same_run = keyframe[position] == state[position] ? same_run + 1 : 0;
+                position++;
+            }
+            size_t changed_end = position - same_run;
+            position = changed_end;
+
+            write_count(out, unchanged);
+            write_count(out, changed_end - changed_start);
+            for (size_t i = changed_start; i < changed_end; i++) {
+                out.push_back(keyframe[i] ^ state[i]);
+            }
+        }
+    }
+
+    static bool decode_delta(const vector<char>& keyframe, const vector<char>& delta, vector<char>& out) {
+        out.assign(keyframe.begin(), keyframe.end());
+        size_t position = 0, offset = 0;
+        while (position < delta.size()) {
+            size_t unchanged, changed;
+            if (!read_count(delta, position, unchanged) || !read_count(delta, position, changed))
+                return false;
+            offset += unchanged;
+            if (changed > out.size() - offset || changed > delta.size() - position)
+                return false;
+            for (size_t i = 0; i < changed; i++) {
+                out[offset + i] ^= delta[position + i];
+            }
+            offset += changed;
+            position += changed;
+        }
+        return true;
+    }
+
+    //Getters
+    size_t get_frame_count() const { return frames.size(); }
+    size_t get_used_bytes() const { return used_bytes; }
+};
@@ -0,0 +1,228 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+using namespace std;
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//What gets saved for a player
+struct save_record {
+    string player_name;
+    int level = 1;
+    int play_time = 0; //Seconds
+    int health = 3;
+    int power_up_ticks = 0; //Ticks left on the speed boost (0 if there isn't one)
+};
+
+//CRC-32 (the zlib/PNG one), used to spot saves that were damaged or only half written
+inline uint32_t save_crc32(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+//A save record. One fixed size binary record, so reading it is a single read and a few copies (no text parsing)
+//Used on its own as the single player save file, and as the slots of the profile store (see profile_store.h)
+//Layout (little endian, 64 bytes):
+//  "SSAV", version (u32), level (i32), play time (i32), health (i32), power up ticks (i32), name length (u32), name (32 bytes, zero padded), CRC-32 of everything before it (u32)
+//Version 1 had no health or power ups and a 40 byte name straight after the play time. It's still read
+//Saves are written to a temporary file, flushed to the disk, then moved over the old save, so a crash or power cut never leaves a broken save behind
+class save_file {
+public:
+    static const uint32_t version = 2;
+    static const size_t max_name_length = 32;
+    static const size_t record_size = 64;
+
+private:
+    static const size_t checksum_offset = record_size - 4;
+
+    static void write_value(char* out, uint32_t value) {
+        for (size_t i = 0; i < 4; i++) {
+            out[i] = (char)((value >> (8 * i)) & 0xFF);
+        }
+    }
+    static uint32_t read_value(const char* data) {
+        uint32_t value = 0;
+        for (size_t i = 0; i < 4; i++) {
+            value |= (uint32_t)(unsigned char)data[i] << (8 * i);
+        }
+        return value;
+    }
+
+public:
+    //Writes a file and waits until it's actually on the disk (not just in the OS's cache)
+    static bool write_durably(const string& path, const char* data, size_t size) {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        DWORD written = 0;
+        bool ok = WriteFile(file, data, (DWORD)size, &written, nullptr) && written == size && FlushFileBuffers(file);
+        CloseHandle(file);
+        return ok;
+#else
+        int file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (file < 0)
+            return false;
+        bool ok = ::write(file, data, size) == (ssize_t)size && fsync(file) == 0;
+        ok = ::close(file) == 0 && ok;
+        return ok;
+#endif
+    }
+
+    //Overwrites part of a file (creating it if needed) and waits until it's on the disk
+    static bool write_at(const string& path, uint64_t offset, const char* data, size_t size) {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER position;
+        position.QuadPart = (LONGLONG)offset;
+        DWORD written = 0;
+        bool ok = SetFilePointerEx(file, position, nullptr, FILE_BEGIN) && WriteFile(file, data, (DWORD)size, &written, nullptr) && written == size
+            && FlushFileBuffers(file);
+        CloseHandle(file);
+        return ok;
+#else
+        int file = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+        if (file < 0)
+            return false;
+        bool ok = pwrite(file, data, size, (off_t)offset) == (ssize_t)size && fsync(file) == 0;
+        ok = ::close(file) == 0 && ok;
+        return ok;
+#endif
+    }
+
+    //Moves the new save over the old one in one step. Either the old save or the new one is there afterwards, never a mix
+    static bool replace_file(const string& from, const string& to) {
+#ifdef _WIN32
+        return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+        if (rename(from.c_str(), to.c_str()) != 0)
+            return false;
+        //The rename itself is only on the disk once the directory is
+        size_t slash = to.find_last_of('/');
+        int directory = ::open(slash == string::npos ? "." : to.substr(0, slash).c_str(), O_RDONLY);
+        if (directory >= 0) {
+            fsync(directory);
+            ::close(directory);
+        }
+        return true;
+#endif
+    }
+
+    //Turns a record into its bytes
+    static void encode(const save_record& record, char* data) {
+        memset(data, 0, record_size);
+        size_t name_length = record.player_name.size() < max_name_length ? record.player_name.size() : max_name_length;
+        memcpy(data, "SSAV", 4);
+        write_value(data + 4, version);
+        write_value(data + 8, (uint32_t)record.level);
+        write_value(data + 12, (uint32_t)record.play_time);
+        write_value(data + 16, (uint32_t)record.health);
+        write_value(data + 20, (uint32_t)record.power_up_ticks);
+        write_value(data + 24, (uint32_t)name_length);
+        memcpy(data + 28, record.player_name.data(), name_length);
+        write_value(data + checksum_offset, save_crc32(data, checksum_offset));
+    }
+
+    //Reads a record back. Returns false if it's damaged
+    static bool decode(const char* data, save_record& out) {
+        uint32_t file_version = read_value(data + 4);
+        if (memcmp(data, "SSAV", 4) != 0 || (file_version != 1 && file_version != version) || read_value(data + checksum_offset) != save_crc32(data, checksum_offset))
+            return false;
+        out.level = (int)read_value(data + 8);
+        out.play_time = (int)read_value(data + 12);
+        if (file_version == 1) {
+            uint32_t name_length = read_value(data + 16);
+            if (name_length > 40)
+                return false;
+            out.health = 3;
+            out.power_up_ticks = 0;
+            out.player_name.assign(data + 20, name_length);
+            return true;
+        }
+        uint32_t name_length = read_value(data + 24);
+        if (name_length > max_name_length)
+            return false;
+        out.health = (int)read_value(data + 16);
+        out.power_up_ticks = (int)read_value(data + 20);
+        out.player_name.assign(data + 28, name_length);
+        return true;
+    }
+
+    static string get_save_path() { return "playerStats.sav"; }
+    //The old text save ("name,level,seconds"), only read to move an existing save over to the profile store
+    static string get_legacy_save_path() { return "playerStats.txt"; }
+
+    static bool read(const string& path, save_record& out) {
+        char data[record_size];
+        ifstream reader(path, ios::binary);
+        if (!reader.read(data, record_size))
+            return false;
+        if (!decode(data, out)) {
+            cout << "Save file " << path << " is damaged" << endl;
+            return false;
+        }
+        return true;
+    }
+
+    static bool write(const string& path, const save_record& record) {
+        char data[record_size];
+        encode(record, data);
+        string temporary_path = path + ".tmp";
+        if (!write_durably(temporary_path, data, record_size)) {
+            cout << "Error writing save file: " << temporary_path << endl;
+            return false;
+        }
+        if (!replace_file(temporary_path, path)) {
+            cout << "Error replacing save file: " << path << endl;
+            remove(temporary_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    //Reads an old "name,level,seconds" save. Bad numbers fall back to level 1 and no play time, like the old loader did
+    static bool read_legacy(const string& path, save_record& out) {
+        ifstream reader(path);
+        string name, level, play_time;
+        if (!getline(reader, name, ','))
+            return false;
+        getline(reader, level, ',');
+        getline(reader, play_time);
+        out.player_name = name;
+        if (!(stringstream(level) >> out.level))
+            out.level = 1;
+        if (!(stringstream(play_time) >> out.play_time) || out.play_time < 0)
+            out.play_time = 0;
+        return true;
+    }
+
+    //Loads the single player save, or the old text save if there isn't one. Only used to move old saves into the profile store
+    static bool load(save_record& out) {
+        return read(get_save_path(), out) || read_legacy(get_legacy_save_path(), out);
+    }
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include <string>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+using namespace std;
+
+//Our files
+#include "profile_store.h"
+
+//Writes saves into the profile store on its own thread, so the game never waits on the disk
+//Only the newest save for each player matters: if several are asked for while one is being written, just the last one is written next
+//Whatever was asked for last is always written before the writer is destroyed
+class save_writer {
+private:
+    profile_store& profiles;
+    thread writer;
+    mutex pending_mutex;
+    condition_variable changed; //Signalled when a save is asked for, when one finishes, and when stopping
+    map<string, save_record> pending; //Newest save asked for, per player
+    bool writing = false;
+    bool stopping = false;
+
+    void run() {
+        unique_lock<mutex> lock(pending_mutex);
+        while (true) {
+            changed.wait(lock, [this] { return !pending.empty() || stopping; });
+            if (pending.empty())
+                return;
+            save_record record = pending.begin()->second;
+            pending.erase(pending.begin());
+            writing = true;
+            lock.unlock();
+            profiles.save(record);
+            lock.lock();
+            writing = false;
+            changed.notify_all();
+        }
+    }
+
+public:
+    //Constructor. The store has to outlive the writer
+    save_writer(profile_store& profiles) : profiles(profiles) {
+        writer = thread(&save_writer::run, this);
+    }
+    //Destructor. Writes the last save before returning
+    ~save_writer() {
+        {
+            lock_guard<mutex> lock(pending_mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        writer.join();
+    }
+    save_writer(const save_writer&) = delete;
+    save_writer& operator=(const save_writer&) = delete;
+
+    //Asks for a save to be written. Never waits on the disk
+    void save(const save_record& record) {
+        {
+            lock_guard<mutex> lock(pending_mutex);
+            pending[record.player_name] = record;
+        }
+        changed.notify_all();
+    }
+
+    //Waits until every save asked for so far is on the disk
+    void flush() {
+        unique_lock<mutex> lock(pending_mutex);
+        changed.wait(lock, [this] { return pending.empty() && !writing; });
+    }
+};
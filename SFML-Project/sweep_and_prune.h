@@ -0,0 +1,181 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <limits>
+using namespace std;
+
+//SFML files
+#include "SFML/Graphics.hpp"
+//SFML namespace
+using namespace sf;
+
+//Two objects whose bounds overlap (first < second, both are indexes into the level)
+struct overlap_pair {
+    int first;
+    int second;
+};
+
+//Sweep and prune broadphase along the x axis
+//Object edges are kept sorted between ticks and re-sorted with insertion sort. Objects barely move between ticks,
+//so the list is almost sorted already and each swap tells us about a pair starting or stopping to overlap on x
+class sweep_and_prune {
+private:
+    //The left (min) or right (max) edge of an object
+    struct endpoint {
+        float value;
+        int object;
+        bool is_max;
+    };
+
+    vector<endpoint> endpoints; //Sorted by value
+    vector<FloatRect> bounds; //Bounds of every object this tick
+    //Pairs overlapping on x, mapped to whether they overlap on y as well (touching)
+    unordered_map<Uint64, bool> x_pairs;
+
+    //Pairs that started or stopped touching during the last update
+    vector<overlap_pair> begun_pairs;
+    vector<overlap_pair> ended_pairs;
+
+    static Uint64 get_pair_key(int a, int b) {
+        if (a > b) swap(a, b);
+        return (static_cast<Uint64>(a) << 32) | static_cast<Uint32>(b);
+    }
+    static overlap_pair get_pair(Uint64 key) {
+        return { static_cast<int>(key >> 32), static_cast<int>(key & 0xFFFFFFFF) };
+    }
+
+    //Objects out of play (see game_object::is_active) are given empty bounds before everything else on the axis,
+    //so they never pair with anything and coming back into play crosses every edge it needs to
+    template <typename object>
+    static FloatRect get_bounds(object* obj) {
+        if (obj->is_active())
+            return obj->get_shape().getGlobalBounds();
+        return FloatRect(-numeric_limits<float>::max(), 0, 0, 0);
+    }
+
+    //Touching edges don't count as overlapping, and empty bounds never overlap (the same as FloatRect::intersects)
+    bool overlaps_x(int a, int b) {
+        if (bounds[a].width <= 0 || bounds[b].width <= 0)
+            return false;
+        return bounds[a].left < bounds[b].left + bounds[b].width && bounds[b].left < bounds[a].left + bounds[a].width;
+    }
+    bool overlaps_y(int a, int b) {
+        if (bounds[a].height <= 0 || bounds[b].height <= 0)
+            return false;
+        return bounds[a].top < bounds[b].top + bounds[b].height && bounds[b].top < bounds[a].top + bounds[a].height;
+    }
+
+    //Whether endpoint a has to be sorted before endpoint b. On a tie max edges go first, so touching objects aren't paired
+    static bool comes_before(const endpoint& a, const endpoint& b) {
+        if (a.value != b.value)
+            return a.value < b.value;
+        return a.is_max && !b.is_max;
+    }
+
+    void add_x_pair(int a, int b) {
+        if (x_pairs.count(get_pair_key(a, b)))
+            return;
+        bool touching = overlaps_y(a, b);
+        x_pairs[get_pair_key(a, b)] = touching;
+        if (touching)
+            begun_pairs.push_back(get_pair(get_pair_key(a, b)));
+    }
+
+    void remove_x_pair(int a, int b) {
+        auto found = x_pairs.find(get_pair_key(a, b));
+        if (found == x_pairs.end())
+            return;
+        if (found->second)
+            ended_pairs.push_back(get_pair(found->first));
+        x_pairs.erase(found);
+    }
+
+public:
+    //Constructor (default)
+    sweep_and_prune() = default;
+
+    //Build everything from scratch (called when the level changes). Every touching pair is reported as begun
+    template <typename object_list>
+    void rebuild(const object_list& objects) {
+        endpoints.clear();
+        bounds.clear();
+        x_pairs.clear();
+        begun_pairs.clear();
+        ended_pairs.clear();
+
+        for (size_t i = 0; i < objects.size(); i++) {
+            bounds.push_back(get_bounds(objects[i]));
+            endpoints.push_back({ bounds[i].left, (int)i, false });
+            endpoints.push_back({ bounds[i].left + bounds[i].width, (int)i, true });
+        }
+        sort(endpoints.begin(), endpoints.end(), comes_before);
+
+        //Sweep once, keeping track of which objects are open at each point
+        vector<int> open_objects;
+        for (const endpoint& point : endpoints) {
+            if (point.is_max) {
+                auto open = find(open_objects.begin(), open_objects.end(), point.object);
+                if (open != open_objects.end())
+                    open_objects.erase(open);
+            }
+            else if (bounds[point.object].width > 0) {
+                for (int other : open_objects) {
+                    add_x_pair(point.object, other);
+                }
+                open_objects.push_back(point.object);
+            }
+        }
+    }
+
+    //Update with the objects' new bounds. Afterwards get_begun_pairs()/get_ended_pairs() hold the changes since the last update
+    template <typename object_list>
+    void update(const object_list& objects) {
+        begun_pairs.clear();
+        ended_pairs.clear();
+
+        for (size_t i = 0; i < objects.size(); i++) {
+            bounds[i] = get_bounds(objects[i]);
+        }
+        for (endpoint& point : endpoints) {
+            point.value = point.is_max ? bounds[point.object].left + bounds[point.object].width : bounds[point.object].left;
+        }
+
+        //Insertion sort. Every swap is an edge of one object passing an edge of another
+        for (size_t i = 1; i < endpoints.size(); i++) {
+            endpoint point = endpoints[i];
+            size_t j = i;
+            while (j > 0 && comes_before(point, endpoints[j - 1])) {
+                const endpoint& passed = endpoints[j - 1];
+                //A left edge moved past a right edge: the objects may now overlap on x
+                //(An object coming back into play starts with its own edges the wrong way round, which isn't a pair)
+                if (!point.is_max && passed.is_max && point.object != passed.object) {
+                    if (overlaps_x(point.object, passed.object))
+                        add_x_pair(point.object, passed.object);
+                }
+                //A right edge moved past a left edge: the objects no longer overlap on x
+                else if (point.is_max && !passed.is_max) {
+                    remove_x_pair(point.object, passed.object);
+                }
+                endpoints[j] = endpoints[j - 1];
+                j--;
+            }
+            endpoints[j] = point;
+        }
+
+        //Pairs that already overlapped on x may have started or stopped overlapping on y
+        for (auto& pair : x_pairs) {
+            overlap_pair objects_in_pair = get_pair(pair.first);
+            bool touching = overlaps_y(objects_in_pair.first, objects_in_pair.second);
+            if (touching && !pair.second)
+                begun_pairs.push_back(objects_in_pair);
+            else if (!touching && pair.second)
+                ended_pairs.push_back(objects_in_pair);
+            pair.second = touching;
+        }
+    }
+
+    //Getters
+    const vector<overlap_pair>& get_begun_pairs() { return begun_pairs; }
+    const vector<overlap_pair>& get_ended_pairs() { return ended_pairs; }
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <cmath>
+#include <limits>
+using namespace std;
+
+//SFML files
+#include "SFML/Graphics.hpp"
+//SFML namespace
+using namespace sf;
+
+//When and where a moving box first touches another box
+struct sweep_result {
+    bool hit = false;
+    float time = 1; //Fraction of the movement done before the boxes touch (0 to 1)
+    Vector2f normal; //Surface normal of the side that was hit, pointing back at the moving box
+};
+
+//Sweep a box along a movement vector against a box that isn't moving (swept AABB)
+//Boxes that already overlap at the start don't count as a hit
+inline sweep_result sweep_box(const FloatRect& moving, Vector2f motion, const FloatRect& obstacle) {
+    sweep_result result;
+    const float infinity = numeric_limits<float>::infinity();
+
+    float moving_right = moving.left + moving.width;
+    float moving_bottom = moving.top + moving.height;
+    float obstacle_right = obstacle.left + obstacle.width;
+    float obstacle_bottom = obstacle.top + obstacle.height;
+
+    //Time the box enters and leaves the obstacle's span on each axis
+    float x_entry, x_exit, y_entry, y_exit;
+    if (motion.x > 0) {
+        x_entry = (obstacle.left - moving_right) / motion.x;
+        x_exit = (obstacle_right - moving.left) / motion.x;
+    }
+    else if (motion.x < 0) {
+        x_entry = (obstacle_right - moving.left) / motion.x;
+        x_exit = (obstacle.left - moving_right) / motion.x;
+    }
+    else {
+        //Not moving on x, so the spans have to overlap already
+        if (moving_right <= obstacle.left || moving.left >= obstacle_right)
+            return result;
+        x_entry = -infinity;
+        x_exit = infinity;
+    }
+
+    if (motion.y > 0) {
+        y_entry = (obstacle.top - moving_bottom) / motion.y;
+        y_exit = (obstacle_bottom - moving.top) / motion.y;
+    }
+    else if (motion.y < 0) {
+        y_entry = (obstacle_bottom - moving.top) / motion.y;
+        y_exit = (obstacle.top - moving_bottom) / motion.y;
+    }
+    else {
+        if (moving_bottom <= obstacle.top || moving.top >= obstacle_bottom)
+            return result;
+        y_entry = -infinity;
+        y_exit = infinity;
+    }
+
+    float entry = max(x_entry, y_entry);
+    float exit = min(x_exit, y_exit);
+    //No overlap during the movement, or overlapping from the start
+    if (entry >= exit || entry < 0 || entry > 1)
+        return result;
+
+    result.hit = true;
+    result.time = entry;
+    if (x_entry > y_entry)
+        result.normal = Vector2f(motion.x > 0 ? -1.0f : 1.0f, 0);
+    else
+        result.normal = Vector2f(0, motion.y > 0 ? -1.0f : 1.0f);
+    return result;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <map>
+#include <mutex>
+using namespace std;
+
+//SFML files
+#include "SFML/Graphics.hpp"
+//SFML namespace
+using namespace sf;
+
+//Shared textures, loaded once per file and reused by every object that draws with them
+//Textures are stored in a map so references handed out stay valid for the rest of the program
+//Lookups are locked, so levels can be built on worker threads
+class texture_cache {
+private:
+    static map<string, Texture>& get_textures() {
+        static map<string, Texture> textures;
+        return textures;
+    }
+    static mutex& get_mutex() {
+        static mutex textures_mutex;
+        return textures_mutex;
+    }
+
+public:
+    //Returns the texture for a file, loading it the first time it's asked for
+    static Texture& get_texture(const string& file_name) {
+        lock_guard<mutex> lock(get_mutex());
+        map<string, Texture>& textures = get_textures();
+        auto found = textures.find(file_name);
+        if (found != textures.end()) {
+            return found->second;
+        }
+
+        Texture& texture = textures[file_name];
+        if (!texture.loadFromFile(file_name)) {
+            cout << "Error loading texture file: " << file_name << endl;
+        }
+        return texture;
+    }
+
+    //Returns the cache slot for a file without loading anything. The asset loader fills it in on the render thread
+    static Texture& reserve_texture(const string& file_name) {
+        lock_guard<mutex> lock(get_mutex());
+        return get_textures()[file_name];
+    }
+};